@@ -0,0 +1,8 @@
+#include "FreeRTOS.h"
+
+/* Default of the task switch hook called through traceTASK_SWITCHED_IN (see FreeRTOSConfig.h).
+   It is weak, so that the kernel does not depend on whoever wants to see the task switches. */
+__attribute__((weak)) void vApplicationTaskSwitchedIn(void *task)
+{
+    (void)task;
+}
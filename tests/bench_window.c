@@ -0,0 +1,72 @@
+// Host benchmark of one hot path of the window system, chosen with BENCH_ID (a WindowBenchmark). It is built once per
+// hot path, and prints the statistics of its samples as CSV, as Window_printBenchmarks does on the device.
+// Focus switching is measured while other tasks write into their windows as fast as they can.
+// Usage: bench_<name> [samples]
+
+#include "test.h"
+
+#ifndef BENCH_ID
+#define BENCH_ID WINDOW_BENCH_GLYPH
+#endif
+
+#define BENCH_SAMPLES 200
+#define BENCH_WRITERS 3
+
+static uint samples = BENCH_SAMPLES;
+
+// Background output, which focus switching is measured against
+static void Bench_writer(void *param)
+{
+    TermWindow *w = param;
+    for (uint i = 0;; i++)
+    {
+        Window_printf(w, "%6u background output %08x\n", i, i * 2654435761u);
+        if (i % 8 == 0)
+            Window_taskYield();
+    }
+}
+
+static void Bench_task(void *param)
+{
+    TermWindow *w = Window_createWindow(10, 20, 400, 300, "bench", WHITE);
+    Window_createWindow(430, 20, 200, 100, "other", GREEN);
+    takeKeySemaphore();
+    Window_setActiveWindow(w);
+    giveKeySemaphore();
+    while (!w->focusShown)
+        Window_taskYield();
+
+    if (BENCH_ID == WINDOW_BENCH_FOCUS)
+        for (int i = 0; i < BENCH_WRITERS; i++)
+        {
+            TermWindow *bw = Window_createWindow(10 + 210 * i, 340, 200, 120, "writer", YELLOW);
+            Window_startTask(bw, Bench_writer, "writer", WINDOW_TASK_STACK);
+        }
+
+    // glyphs are drawn at every text size, the other benchmarks run once
+    WindowBenchResult r[MAX_TEXT_SIZE];
+    uint n = 0;
+    for (uint s = 1; s <= ((BENCH_ID == WINDOW_BENCH_GLYPH) ? MAX_TEXT_SIZE : 1); s++)
+    {
+        Window_setTextSize(w, s);
+        bool done = Window_runBenchmark(w, BENCH_ID, samples, &r[n]);
+        CHECK(done && r[n].samples > 0);
+        CHECK(r[n].minUs <= r[n].medianUs && r[n].medianUs <= r[n].p95Us && r[n].p95Us <= r[n].maxUs);
+        if (done)
+            n++;
+    }
+    Window_printBenchmarks(BENCH_ID == WINDOW_BENCH_FOCUS ? "host_loaded" : "host", r, n);
+
+    // only the CSV goes to stdout
+    fflush(stdout);
+    exit(testFailures ? 1 : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+        samples = atoi(argv[1]);
+    Test_initIO();
+    Test_runTask(Bench_task, "bench");
+    return 0;
+}
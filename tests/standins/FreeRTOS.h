@@ -0,0 +1,43 @@
+#ifndef _STANDIN_FREERTOS_H
+#define _STANDIN_FREERTOS_H
+
+// Host stand-in for the FreeRTOS kernel: tasks are threads, which all run at once whatever their priority,
+// a tick is a millisecond and critical sections are one lock shared by all tasks
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#define configMINIMAL_STACK_SIZE 128
+#define configCHECK_FOR_STACK_OVERFLOW 0
+#define tskKERNEL_VERSION_NUMBER "host"
+
+void *pvPortMalloc(size_t size);
+void vPortFree(void *p);
+
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+void vPortYield(void);
+
+// Task switch hook, as traceTASK_SWITCHED_IN calls it on the device. Called when a task starts running
+// and whenever it wakes up in the kernel, inside a critical section.
+void vApplicationTaskSwitchedIn(void *task);
+
+#define taskENTER_CRITICAL() vPortEnterCritical()
+#define taskEXIT_CRITICAL() vPortExitCritical()
+#define taskYIELD() vPortYield()
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _STANDIN_GFX_H
+#define _STANDIN_GFX_H
+
+// Host stand-in for the GFX library. Its font is made up, but every character has its own glyph,
+// which is all the window library needs when it captures the font.
+
+#include "pico/stdlib.h"
+
+void GFX_drawPixel(short x, short y, uint16_t color);
+void GFX_drawRect(short x, short y, short w, short h, uint16_t color);
+void GFX_fillRect(short x, short y, short w, short h, uint16_t color);
+void GFX_drawCircle(short x0, short y0, short r, uint16_t color);
+void GFX_fillCircle(short x0, short y0, short r, uint16_t color);
+void GFX_setCursor(short x, short y);
+void GFX_setTextColor(uint16_t color);
+void GFX_setTextSize(uint8_t size);
+void GFX_write(uint8_t c);
+void GFX_printf(const char *format, ...);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _STANDIN_HARDWARE_GPIO_H
+#define _STANDIN_HARDWARE_GPIO_H
+
+#include "pico/stdlib.h"
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+
+#endif
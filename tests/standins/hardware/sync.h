@@ -0,0 +1,14 @@
+#ifndef _STANDIN_HARDWARE_SYNC_H
+#define _STANDIN_HARDWARE_SYNC_H
+
+#include "pico/stdlib.h"
+
+// Hardware spin locks, as spinning flags shared by the threads
+typedef volatile uint32_t spin_lock_t;
+
+spin_lock_t *spin_lock_init(uint lock_num);
+int spin_lock_claim_unused(bool required);
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _STANDIN_PICO_STDLIB_H
+#define _STANDIN_PICO_STDLIB_H
+
+// Host stand-in for the parts of the Pico SDK the window library uses
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+#define PICO_ERROR_TIMEOUT (-1)
+
+void panic(const char *fmt, ...);
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+void sleep_ms(uint32_t ms);
+int getchar_timeout_us(uint32_t timeout);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _STANDIN_PS2_H
+#define _STANDIN_PS2_H
+
+// Host stand-in for the PS/2 driver, reading keys which the tests push with StandIn_pushKeys
+
+#include "pico/stdlib.h"
+
+#define PS2_SHIFT_TAB 0x1f
+
+void PS2_init(uint data_pin, uint clock_pin);
+bool PS2_keyAvailable(void);
+char PS2_readKey(void);
+
+#endif
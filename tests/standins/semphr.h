@@ -0,0 +1,14 @@
+#ifndef _STANDIN_SEMPHR_H
+#define _STANDIN_SEMPHR_H
+
+#include "queue.h"
+
+// Binary semaphores are queues of one empty item, as in FreeRTOS. The task which took one is remembered,
+// so that deleting a task which still holds it is caught.
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks);
+
+#endif
@@ -0,0 +1,796 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/spi.h"
+#include "hardware/sync.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "vga.h"
+#include "gfx.h"
+#include "ps2.h"
+
+#include "standins.h"
+
+#define SCREEN_WIDTH 640
+#define SCREEN_HEIGHT 480
+#define SCREEN_STRIDE (SCREEN_WIDTH / 2)
+#define INPUT_LEN 256
+#define SPIN_LOCKS 32
+
+static uint64_t startUs;
+
+// Every queue, semaphore, notification and the scheduler state is guarded by the one kernel lock,
+// and every change to them is broadcast to all waiting tasks, which check again
+static pthread_mutex_t kernelLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t kernelCond;
+
+// Critical sections, which nest
+static pthread_mutex_t criticalLock;
+
+static pthread_mutex_t inputLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t mallocLock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t StandIn_clockUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+__attribute__((constructor)) static void StandIn_init()
+{
+    startUs = StandIn_clockUs();
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&kernelCond, &ca);
+
+    pthread_mutexattr_t ma;
+    pthread_mutexattr_init(&ma);
+    pthread_mutexattr_settype(&ma, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&criticalLock, &ma);
+}
+
+// Pico SDK
+
+void panic(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "panic: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    abort();
+}
+
+uint64_t time_us_64(void)
+{
+    return StandIn_clockUs() - startUs;
+}
+
+uint32_t time_us_32(void)
+{
+    return (uint32_t)time_us_64();
+}
+
+void sleep_ms(uint32_t ms)
+{
+    usleep(ms * 1000);
+}
+
+typedef struct InputBuffer
+{
+    char keys[INPUT_LEN];
+    uint head, count;
+
+} InputBuffer;
+
+static InputBuffer ps2Keys, stdioChars;
+
+static void StandIn_push(InputBuffer *b, const char *keys, uint len)
+{
+    pthread_mutex_lock(&inputLock);
+    for (int i = 0; i < len && b->count < INPUT_LEN; i++)
+        b->keys[(b->head + b->count++) % INPUT_LEN] = keys[i];
+    pthread_mutex_unlock(&inputLock);
+}
+
+static int StandIn_pop(InputBuffer *b)
+{
+    int c = -1;
+    pthread_mutex_lock(&inputLock);
+    if (b->count)
+    {
+        c = (unsigned char)b->keys[b->head];
+        b->head = (b->head + 1) % INPUT_LEN;
+        b->count--;
+    }
+    pthread_mutex_unlock(&inputLock);
+    return c;
+}
+
+void StandIn_pushKeys(const char *keys, uint len)
+{
+    StandIn_push(&ps2Keys, keys, len);
+}
+
+void StandIn_pushStdio(const char *chars, uint len)
+{
+    StandIn_push(&stdioChars, chars, len);
+}
+
+int getchar_timeout_us(uint32_t timeout)
+{
+    int c = StandIn_pop(&stdioChars);
+    return c < 0 ? PICO_ERROR_TIMEOUT : c;
+}
+
+void gpio_init(uint gpio)
+{
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+}
+
+void gpio_put(uint gpio, bool value)
+{
+}
+
+uint spi_init(spi_inst_t *spi, uint baudrate)
+{
+    return baudrate;
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len)
+{
+    return len;
+}
+
+static spin_lock_t spinLocks[SPIN_LOCKS];
+static int spinLocksClaimed;
+
+spin_lock_t *spin_lock_init(uint lock_num)
+{
+    spinLocks[lock_num] = 0;
+    return &spinLocks[lock_num];
+}
+
+int spin_lock_claim_unused(bool required)
+{
+    int n = __sync_fetch_and_add(&spinLocksClaimed, 1);
+    if (n >= SPIN_LOCKS)
+        panic("No spin locks left");
+    return n;
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock)
+{
+    while (__sync_lock_test_and_set(lock, 1))
+        ;
+    return 0;
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq)
+{
+    __sync_lock_release(lock);
+}
+
+// Tasks
+
+struct StandInTask
+{
+    char name[16];
+    TaskFunction_t func;
+    void *param;
+    uint32_t stackWords;
+    uint32_t notify;
+    bool deleted; // the thread ends at its next call into the kernel
+    int held;     // semaphores taken and not given back
+    int critical; // nesting of critical sections
+};
+
+static struct StandInTask mainTask = {.name = "main"};
+static __thread struct StandInTask *current;
+static bool started;
+
+static struct StandInTask *StandIn_current()
+{
+    if (current == NULL)
+        current = &mainTask;
+    return current;
+}
+
+// Called with the kernel lock held
+static void StandIn_checkDeleted(struct StandInTask *t)
+{
+    if (t->deleted)
+    {
+        pthread_mutex_unlock(&kernelLock);
+        pthread_exit(NULL);
+    }
+}
+
+static uint64_t StandIn_deadline(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? UINT64_MAX : StandIn_clockUs() + (uint64_t)ticks * 1000;
+}
+
+__attribute__((weak)) void vApplicationTaskSwitchedIn(void *task)
+{
+}
+
+// Called without the kernel lock, which critical sections must not be taken under
+static void StandIn_switchedIn(struct StandInTask *t)
+{
+    vPortEnterCritical();
+    vApplicationTaskSwitchedIn(t);
+    vPortExitCritical();
+}
+
+// Waits for a change, with the kernel lock held. Returns false once the deadline has passed.
+static bool StandIn_wait(uint64_t deadline)
+{
+    if (deadline == UINT64_MAX)
+        pthread_cond_wait(&kernelCond, &kernelLock);
+    else
+    {
+        if (StandIn_clockUs() >= deadline)
+            return false;
+        struct timespec ts = {deadline / 1000000, (deadline % 1000000) * 1000};
+        pthread_cond_timedwait(&kernelCond, &kernelLock, &ts);
+    }
+    StandIn_checkDeleted(StandIn_current());
+    if (started)
+    {
+        pthread_mutex_unlock(&kernelLock);
+        StandIn_switchedIn(StandIn_current());
+        pthread_mutex_lock(&kernelLock);
+        StandIn_checkDeleted(StandIn_current());
+    }
+    return true;
+}
+
+static void *StandIn_run(void *p)
+{
+    struct StandInTask *t = p;
+    current = t;
+
+    pthread_mutex_lock(&kernelLock);
+    while (!started)
+        StandIn_wait(UINT64_MAX);
+    pthread_mutex_unlock(&kernelLock);
+
+    StandIn_switchedIn(t);
+    t->func(t->param);
+    panic("Task %s returned from its function", t->name);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t func, const char *name, uint32_t stackWords, void *param, UBaseType_t priority, TaskHandle_t *handle)
+{
+    struct StandInTask *t = calloc(1, sizeof(struct StandInTask));
+    strncpy(t->name, name, sizeof(t->name) - 1);
+    t->func = func;
+    t->param = param;
+    t->stackWords = stackWords;
+    if (handle != NULL)
+        *handle = t;
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, StandIn_run, t) != 0)
+        panic("Could not start task %s", name);
+    pthread_attr_destroy(&attr);
+    return pdPASS;
+}
+
+// The library must only delete tasks which hold no locks, so that is checked here. The task's thread ends
+// at its next call into the kernel, or right away when it is waiting in one.
+void vTaskDelete(TaskHandle_t task)
+{
+    struct StandInTask *self = StandIn_current();
+    if (task == NULL)
+        task = self;
+
+    pthread_mutex_lock(&kernelLock);
+    if (task->held || task->critical)
+        panic("Task %s deleted while holding %d semaphores and %d critical sections", task->name, task->held, task->critical);
+    task->deleted = true;
+    pthread_cond_broadcast(&kernelCond);
+    StandIn_checkDeleted(self);
+    pthread_mutex_unlock(&kernelLock);
+}
+
+// Only suspending the calling task is supported, which then waits to be deleted
+void vTaskSuspend(TaskHandle_t task)
+{
+    if (task != NULL && task != StandIn_current())
+        panic("Only the calling task can be suspended");
+    pthread_mutex_lock(&kernelLock);
+    while (true)
+        StandIn_wait(UINT64_MAX);
+}
+
+// The calling thread stays in the scheduler, as on the device, so tests end from one of their tasks
+void vTaskStartScheduler(void)
+{
+    pthread_mutex_lock(&kernelLock);
+    started = true;
+    pthread_cond_broadcast(&kernelCond);
+    pthread_mutex_unlock(&kernelLock);
+    while (true)
+        pause();
+}
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+    return started ? taskSCHEDULER_RUNNING : taskSCHEDULER_NOT_STARTED;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return StandIn_current();
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    return (task != NULL ? task : StandIn_current())->name;
+}
+
+// Threads have stacks of their own size, so half of the task's stack is reported as free
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return (task != NULL ? task : StandIn_current())->stackWords / 2;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority)
+{
+}
+
+void vTaskCoreAffinitySet(TaskHandle_t task, UBaseType_t coreMask)
+{
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return time_us_64() / 1000;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    uint64_t deadline = StandIn_deadline(ticks);
+    pthread_mutex_lock(&kernelLock);
+    StandIn_checkDeleted(StandIn_current());
+    while (StandIn_wait(deadline))
+        ;
+    pthread_mutex_unlock(&kernelLock);
+    if (ticks == 0)
+        vPortYield();
+}
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t increment)
+{
+    *previousWake += increment;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(*previousWake - now) > 0)
+        vTaskDelay(*previousWake - now);
+}
+
+void vTaskSetTimeOutState(TimeOut_t *timeout)
+{
+    timeout->start = xTaskGetTickCount();
+}
+
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *timeout, TickType_t *ticksToWait)
+{
+    if (*ticksToWait == portMAX_DELAY)
+        return pdFALSE;
+    TickType_t now = xTaskGetTickCount();
+    TickType_t elapsed = now - timeout->start;
+    if (elapsed >= *ticksToWait)
+    {
+        *ticksToWait = 0;
+        return pdTRUE;
+    }
+    *ticksToWait -= elapsed;
+    timeout->start = now;
+    return pdFALSE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&kernelLock);
+    task->notify++;
+    pthread_cond_broadcast(&kernelCond);
+    pthread_mutex_unlock(&kernelLock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    struct StandInTask *t = StandIn_current();
+    uint64_t deadline = StandIn_deadline(ticks);
+    pthread_mutex_lock(&kernelLock);
+    StandIn_checkDeleted(t);
+    while (t->notify == 0 && StandIn_wait(deadline))
+        ;
+    uint32_t n = t->notify;
+    if (n)
+        t->notify = clearOnExit ? 0 : n - 1;
+    pthread_mutex_unlock(&kernelLock);
+    return n;
+}
+
+void vPortEnterCritical(void)
+{
+    pthread_mutex_lock(&criticalLock);
+    StandIn_current()->critical++;
+}
+
+void vPortExitCritical(void)
+{
+    StandIn_current()->critical--;
+    pthread_mutex_unlock(&criticalLock);
+}
+
+void vPortYield(void)
+{
+    usleep(20);
+}
+
+// Heap
+
+static int mallocFailAfter = -1;
+
+void StandIn_failMalloc(int allocations)
+{
+    pthread_mutex_lock(&mallocLock);
+    mallocFailAfter = allocations;
+    pthread_mutex_unlock(&mallocLock);
+}
+
+void *pvPortMalloc(size_t size)
+{
+    bool fail = false;
+    pthread_mutex_lock(&mallocLock);
+    if (mallocFailAfter == 0)
+        fail = true;
+    else if (mallocFailAfter > 0)
+        mallocFailAfter--;
+    pthread_mutex_unlock(&mallocLock);
+    return fail ? NULL : malloc(size);
+}
+
+void vPortFree(void *p)
+{
+    free(p);
+}
+
+// Queues
+
+struct StandInQueue
+{
+    uint8_t *items;
+    UBaseType_t length, itemSize;
+    UBaseType_t head, count;
+    struct StandInQueue *set;    // queue set the queue belongs to
+    struct StandInTask *holder; // for semaphores, the task which took it
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    struct StandInQueue *q = calloc(1, sizeof(struct StandInQueue));
+    q->items = malloc(length * itemSize + 1);
+    q->length = length;
+    q->itemSize = itemSize;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    free(q->items);
+    free(q);
+}
+
+// Called with the kernel lock held, when there is room
+static void Queue_put(struct StandInQueue *q, const void *item)
+{
+    if (q->itemSize)
+        memcpy(q->items + (q->head + q->count) % q->length * q->itemSize, item, q->itemSize);
+    q->count++;
+    if (q->set != NULL && q->set->count < q->set->length)
+        Queue_put(q->set, &q);
+    pthread_cond_broadcast(&kernelCond);
+}
+
+static void Queue_get(struct StandInQueue *q, void *item)
+{
+    if (q->itemSize)
+        memcpy(item, q->items + q->head * q->itemSize, q->itemSize);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_broadcast(&kernelCond);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    uint64_t deadline = StandIn_deadline(ticks);
+    pthread_mutex_lock(&kernelLock);
+    StandIn_checkDeleted(StandIn_current());
+    while (q->count == q->length && StandIn_wait(deadline))
+        ;
+    bool sent = q->count < q->length;
+    if (sent)
+        Queue_put(q, item);
+    pthread_mutex_unlock(&kernelLock);
+    return sent ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    uint64_t deadline = StandIn_deadline(ticks);
+    pthread_mutex_lock(&kernelLock);
+    StandIn_checkDeleted(StandIn_current());
+    while (q->count == 0 && StandIn_wait(deadline))
+        ;
+    bool received = q->count > 0;
+    if (received)
+        Queue_get(q, item);
+    pthread_mutex_unlock(&kernelLock);
+    return received ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&kernelLock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&kernelLock);
+    return n;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+    pthread_mutex_lock(&kernelLock);
+    q->head = 0;
+    q->count = 0;
+    pthread_cond_broadcast(&kernelCond);
+    pthread_mutex_unlock(&kernelLock);
+    return pdPASS;
+}
+
+QueueSetHandle_t xQueueCreateSet(UBaseType_t length)
+{
+    return xQueueCreate(length, sizeof(QueueHandle_t));
+}
+
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t member, QueueSetHandle_t set)
+{
+    pthread_mutex_lock(&kernelLock);
+    bool added = member->set == NULL && member->count == 0;
+    if (added)
+        member->set = set;
+    pthread_mutex_unlock(&kernelLock);
+    return added ? pdPASS : pdFAIL;
+}
+
+QueueSetMemberHandle_t xQueueSelectFromSet(QueueSetHandle_t set, TickType_t ticks)
+{
+    QueueSetMemberHandle_t member;
+    return xQueueReceive(set, &member, ticks) == pdTRUE ? member : NULL;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    pthread_mutex_lock(&kernelLock);
+    bool given = s->count == 0;
+    if (given)
+    {
+        if (s->holder != NULL)
+            s->holder->held--;
+        s->holder = NULL;
+        Queue_put(s, NULL);
+    }
+    pthread_mutex_unlock(&kernelLock);
+    return given ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks)
+{
+    struct StandInTask *t = StandIn_current();
+    uint64_t deadline = StandIn_deadline(ticks);
+    pthread_mutex_lock(&kernelLock);
+    StandIn_checkDeleted(t);
+    while (s->count == 0 && StandIn_wait(deadline))
+        ;
+    bool taken = s->count > 0;
+    if (taken)
+    {
+        Queue_get(s, NULL);
+        s->holder = t;
+        t->held++;
+    }
+    pthread_mutex_unlock(&kernelLock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+// VGA driver
+
+unsigned char vga_data_array[TXCOUNT];
+
+void VGA_initDisplay(uint vsync_pin, uint hsync_pin, uint r_pin)
+{
+}
+
+void VGA_fillScreen(uint16_t color)
+{
+    memset(vga_data_array, (color & 7) | (color & 7) << 3, TXCOUNT);
+}
+
+void VGA_drawPixel(short x, short y, char color)
+{
+    if (x < 0 || y < 0 || x >= SCREEN_WIDTH || y >= SCREEN_HEIGHT)
+        return;
+    unsigned char *p = &vga_data_array[y * SCREEN_STRIDE + x / 2];
+    if (x % 2)
+        *p = (*p & 0xC7) | (color & 7) << 3;
+    else
+        *p = (*p & 0xF8) | (color & 7);
+}
+
+void dma_memcpy(void *dst, void *src, uint32_t len)
+{
+    memcpy(dst, src, len);
+}
+
+void dma_memset(void *dst, uint8_t value, uint32_t len)
+{
+    memset(dst, value, len);
+}
+
+// GFX library
+
+static short cursorX, cursorY;
+static uint8_t textSize = 1;
+static uint16_t textColor = 7;
+
+void GFX_drawPixel(short x, short y, uint16_t color)
+{
+    VGA_drawPixel(x, y, color);
+}
+
+void GFX_fillRect(short x, short y, short w, short h, uint16_t color)
+{
+    for (int j = y; j < y + h; j++)
+        for (int i = x; i < x + w; i++)
+            VGA_drawPixel(i, j, color);
+}
+
+void GFX_drawRect(short x, short y, short w, short h, uint16_t color)
+{
+    GFX_fillRect(x, y, w, 1, color);
+    GFX_fillRect(x, y + h - 1, w, 1, color);
+    GFX_fillRect(x, y, 1, h, color);
+    GFX_fillRect(x + w - 1, y, 1, h, color);
+}
+
+void GFX_drawCircle(short x0, short y0, short r, uint16_t color)
+{
+    for (int dy = -r; dy <= r; dy++)
+        for (int dx = -r; dx <= r; dx++)
+        {
+            int d = dx * dx + dy * dy;
+            if (d <= r * r + r && d > r * r - r)
+                VGA_drawPixel(x0 + dx, y0 + dy, color);
+        }
+}
+
+void GFX_fillCircle(short x0, short y0, short r, uint16_t color)
+{
+    for (int dy = -r; dy <= r; dy++)
+        for (int dx = -r; dx <= r; dx++)
+            if (dx * dx + dy * dy <= r * r + r)
+                VGA_drawPixel(x0 + dx, y0 + dy, color);
+}
+
+void GFX_setCursor(short x, short y)
+{
+    cursorX = x;
+    cursorY = y;
+}
+
+void GFX_setTextColor(uint16_t color)
+{
+    textColor = color;
+}
+
+void GFX_setTextSize(uint8_t size)
+{
+    textSize = size ? size : 1;
+}
+
+// 5x7 pixels of a made up glyph, different for every character but the blank ones
+static bool GFX_glyphPixel(uint8_t c, int col, int row)
+{
+    if (c == ' ' || c == 0)
+        return false;
+    uint32_t h = (c + 1) * 2654435761u ^ (row + 1) * 40503u;
+    h ^= h >> 13;
+    return (h >> (col + 3 * row % 7)) & 1;
+}
+
+void GFX_write(uint8_t c)
+{
+    if (c == '\n')
+    {
+        cursorX = 0;
+        cursorY += textSize * 8;
+        return;
+    }
+    if (c == '\r')
+        return;
+    if (cursorX + textSize * 6 > SCREEN_WIDTH)
+    {
+        cursorX = 0;
+        cursorY += textSize * 8;
+    }
+    for (int row = 0; row < 7; row++)
+        for (int col = 0; col < 5; col++)
+            if (GFX_glyphPixel(c, col, row))
+                GFX_fillRect(cursorX + col * textSize, cursorY + row * textSize, textSize, textSize, textColor);
+    cursorX += textSize * 6;
+}
+
+void GFX_printf(const char *format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    for (char *p = buf; *p; p++)
+        GFX_write(*p);
+}
+
+// PS/2 driver
+
+void PS2_init(uint data_pin, uint clock_pin)
+{
+}
+
+bool PS2_keyAvailable(void)
+{
+    pthread_mutex_lock(&inputLock);
+    bool available = ps2Keys.count > 0;
+    pthread_mutex_unlock(&inputLock);
+    return available;
+}
+
+char PS2_readKey(void)
+{
+    int c;
+    while ((c = StandIn_pop(&ps2Keys)) < 0)
+        usleep(100);
+    return c;
+}
@@ -0,0 +1,17 @@
+#ifndef _STANDINS_H
+#define _STANDINS_H
+
+// Controls of the host stand-ins, for the tests
+
+#include "pico/stdlib.h"
+
+// Queues keys to be read from the PS/2 keyboard
+void StandIn_pushKeys(const char *keys, uint len);
+
+// Queues characters to be read from stdio
+void StandIn_pushStdio(const char *chars, uint len);
+
+// Makes pvPortMalloc fail once allocations more have succeeded, or never again if allocations is negative
+void StandIn_failMalloc(int allocations);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef _STANDIN_VGA_H
+#define _STANDIN_VGA_H
+
+// Host stand-in for the VGA driver: the framebuffer is plain memory, and DMA transfers are memcpy and memset
+
+#include "pico/stdlib.h"
+
+#define TXCOUNT 153600
+
+extern unsigned char vga_data_array[TXCOUNT];
+
+void VGA_initDisplay(uint vsync_pin, uint hsync_pin, uint r_pin);
+void VGA_fillScreen(uint16_t color);
+void VGA_drawPixel(short x, short y, char color);
+void dma_memcpy(void *dst, void *src, uint32_t len);
+void dma_memset(void *dst, uint8_t value, uint32_t len);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _TEST_H
+#define _TEST_H
+
+// Checks shared by the host tests. Each test is a program which exits with 0 when all of its checks pass.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "window.h"
+#include "window_rtos.h"
+#include "standins.h"
+
+static int testFailures;
+
+#define CHECK(cond)                                                                  \
+    do                                                                               \
+    {                                                                                \
+        if (!(cond))                                                                 \
+        {                                                                            \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            testFailures++;                                                          \
+        }                                                                            \
+    } while (0)
+
+/// @brief Initializes the window system as Window_initIO does on the device, with a key pressed for the splash screen
+static inline void Test_initIO()
+{
+    StandIn_pushKeys(" ", 1);
+    Window_initIO(0, 1, 2, 3, 4);
+}
+
+/// @brief Runs a test function as a task, with the window tasks started by Window_startRTOS. The function ends the test with Test_exit.
+static inline void Test_runTask(TaskFunction_t func, const char *name)
+{
+    xTaskCreate(func, name, WINDOW_TASK_STACK, NULL, 1, NULL);
+    Window_startRTOS();
+}
+
+/// @brief Reports the result of the checks
+/// @return Exit status of the test
+static inline int Test_result(const char *name)
+{
+    if (testFailures)
+        fprintf(stderr, "%s: %d checks failed\n", name, testFailures);
+    else
+        printf("%s: passed\n", name);
+    return testFailures ? 1 : 0;
+}
+
+static inline void Test_exit(const char *name)
+{
+    fflush(stdout);
+    exit(Test_result(name));
+}
+
+#endif
@@ -0,0 +1,92 @@
+// Blits: whole-byte row copies (aligned) and pixel by pixel copies (unaligned, transparent) must give the same pixels
+// as a reference copy, for every alignment and clipping of the image. Also measures blit throughput.
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+#include "window_pixel.h"
+
+#define BLIT_RUNS 500
+
+static uint8_t expected[TXCOUNT];
+
+static WindowImage Test_image(uint16_t width, uint16_t height, uint32_t seed)
+{
+    uint len = FB_BYTES(width) * height;
+    uint8_t *data = malloc(len);
+    for (int i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (seed >> 16) & 0x3F;
+    }
+    return (WindowImage){width, height, data};
+}
+
+static void Test_referenceBlit(TermWindow *w, const WindowImage *img, int x, int y, int transparent)
+{
+    for (int j = 0; j < img->height; j++)
+        for (int i = 0; i < img->width; i++)
+        {
+            uint8_t col = Pixel_get(img->data + FB_BYTES(img->width) * j, i);
+            int px = x + i, py = y + j;
+            if (px >= 0 && py >= 0 && px < w->xRes && py < w->yRes && col != transparent)
+                Pixel_set(expected + FB_STRIDE * (w->yPos + py), w->xPos + px, col);
+        }
+}
+
+static void Test_blits(TermWindow *w)
+{
+    WindowImage odd = Test_image(37, 21, 1);
+    WindowImage even = Test_image(64, 9, 2);
+    memcpy(expected, vga_data_array, TXCOUNT);
+
+    // every parity of source and destination, clipped on each side
+    int positions[][2] = {{-5, -3}, {-4, 2}, {0, 0}, {1, 5}, {2, 30}, {3, -1}, {w->xRes - 20, 40}, {w->xRes - 33, w->yRes - 4}, {w->xRes, 0}, {0, w->yRes}};
+    for (int i = 0; i < sizeof(positions) / sizeof(positions[0]); i++)
+    {
+        int x = positions[i][0], y = positions[i][1];
+        Window_blit(w, &odd, x, y);
+        Test_referenceBlit(w, &odd, x, y, -1);
+        Window_blit(w, &even, x + 7, y + 50);
+        Test_referenceBlit(w, &even, x + 7, y + 50, -1);
+        Window_blitTransparent(w, &odd, x + 3, y + 80, i % 8);
+        Test_referenceBlit(w, &odd, x + 3, y + 80, i % 8);
+    }
+    CHECK(memcmp(expected, vga_data_array, TXCOUNT) == 0);
+
+    free((void *)odd.data);
+    free((void *)even.data);
+}
+
+static uint Test_throughput(TermWindow *w, const WindowImage *img, int x, int transparent)
+{
+    uint64_t start = time_us_64();
+    for (int i = 0; i < BLIT_RUNS; i++)
+        if (transparent < 0)
+            Window_blit(w, img, x, 0);
+        else
+            Window_blitTransparent(w, img, x, 0, transparent);
+    uint64_t us = time_us_64() - start + 1;
+    return (uint64_t)BLIT_RUNS * img->width * img->height / us;
+}
+
+static void Test_blitRate(TermWindow *w)
+{
+    WindowImage img = Test_image(200, 100, 3);
+    uint aligned = Test_throughput(w, &img, 0, -1);
+    uint unaligned = Test_throughput(w, &img, 1, -1);
+    uint keyed = Test_throughput(w, &img, 0, BLACK);
+    printf("benchmark,blit,aligned_mpixel_s,%u,unaligned_mpixel_s,%u,transparent_mpixel_s,%u\n", aligned, unaligned, keyed);
+    CHECK(aligned > unaligned);
+    free((void *)img.data);
+}
+
+int main()
+{
+    Test_initIO();
+    TermWindow *w = Window_createWindow(100, 40, 240, 200, "blit", WHITE);
+    Test_blits(w);
+    Test_blitRate(w);
+    return Test_result("test_blit");
+}
@@ -0,0 +1,109 @@
+// Canvas drawing: filled spans, written as whole framebuffer bytes with only the end pixels set one by one,
+// must give the same pixels as setting every pixel, for every alignment of the ends, and stay inside the window.
+// Also measures the fill rate of spans against pixel by pixel filling.
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+#include "window_pixel.h"
+
+#define FILL_RUNS 200
+
+static uint8_t expected[TXCOUNT];
+
+// Pixel by pixel reference of Window_canvasFillRect
+static void Test_referenceFill(TermWindow *w, int x, int y, int width, int height, uint8_t col)
+{
+    for (int j = y; j < y + height; j++)
+        for (int i = x; i < x + width; i++)
+            if (i >= 0 && j >= 0 && i < w->xRes && j < w->yRes)
+                Pixel_set(expected + FB_STRIDE * (w->yPos + j), w->xPos + i, col);
+}
+
+static void Test_fills(TermWindow *w)
+{
+    WindowRect damage;
+    Window_takeDamage(w, &damage);
+    memcpy(expected, vga_data_array, TXCOUNT);
+
+    // every alignment of both ends, partly outside the window on each side
+    uint8_t col = RED;
+    for (int x = -3; x < 6; x++)
+        for (int len = 0; len < 9; len++)
+        {
+            Window_canvasFillRect(w, x, x + 3, len, 2, col);
+            Test_referenceFill(w, x, x + 3, len, 2, col);
+            Window_canvasHLine(w, w->xRes - x - len, x + 20, len, col);
+            Test_referenceFill(w, w->xRes - x - len, x + 20, len, 1, col);
+            col = (col + 1) % 8;
+        }
+    Window_canvasVLine(w, 7, -5, 200, GREEN);
+    Test_referenceFill(w, 7, -5, 1, 200, GREEN);
+    Window_canvasFillRect(w, -10, w->yRes - 3, w->xRes + 20, 10, BLUE);
+    Test_referenceFill(w, -10, w->yRes - 3, w->xRes + 20, 10, BLUE);
+    Window_canvasPixel(w, w->xRes, 0, WHITE);
+    Window_canvasPixel(w, w->xRes - 1, w->yRes - 1, WHITE);
+    Test_referenceFill(w, w->xRes - 1, w->yRes - 1, 1, 1, WHITE);
+
+    CHECK(memcmp(expected, vga_data_array, TXCOUNT) == 0);
+
+    // the damage covers all of it, and only the window
+    CHECK(Window_takeDamage(w, &damage));
+    CHECK(damage.x == 0 && damage.y == 0 && damage.width == w->xRes && damage.height == w->yRes);
+}
+
+static void Test_shapes(TermWindow *w)
+{
+    memcpy(expected, vga_data_array, TXCOUNT);
+
+    // shapes crossing the edges only draw inside the window
+    Window_canvasLine(w, -50, -20, w->xRes + 40, w->yRes + 30, YELLOW);
+    Window_canvasCircle(w, 0, 0, 30, CYAN);
+    Window_canvasFillCircle(w, w->xRes, w->yRes / 2, 25, MAGENTA);
+    Window_canvasRect(w, -5, -5, w->xRes + 10, w->yRes + 10, WHITE);
+    Window_canvasText(w, w->xRes - 20, 10, "clipped", 2, GREEN);
+
+    bool outside = false, inside = false;
+    for (int y = 0; y < FB_HEIGHT; y++)
+        for (int x = 0; x < FB_WIDTH; x++)
+        {
+            bool changed = Pixel_get(expected + FB_STRIDE * y, x) != Pixel_get(Pixel_row(y), x);
+            if (x >= w->xPos && x < w->xPos + w->xRes && y >= w->yPos && y < w->yPos + w->yRes)
+                inside |= changed;
+            else
+                outside |= changed;
+        }
+    CHECK(inside);
+    CHECK(!outside);
+}
+
+static void Test_fillRate(TermWindow *w)
+{
+    uint64_t pixels = (uint64_t)FILL_RUNS * (w->xRes - 1) * w->yRes;
+
+    uint64_t start = time_us_64();
+    for (int i = 0; i < FILL_RUNS; i++)
+        Window_canvasFillRect(w, 1, 0, w->xRes - 1, w->yRes, i % 8);
+    uint64_t spanUs = time_us_64() - start + 1;
+
+    start = time_us_64();
+    for (int i = 0; i < FILL_RUNS; i++)
+        for (int y = 0; y < w->yRes; y++)
+            for (int x = 1; x < w->xRes; x++)
+                Window_canvasPixel(w, x, y, i % 8);
+    uint64_t pixelUs = time_us_64() - start + 1;
+
+    printf("benchmark,canvas_fill,spans_mpixel_s,%u,pixels_mpixel_s,%u\n", (uint)(pixels / spanUs), (uint)(pixels / pixelUs));
+    CHECK(spanUs < pixelUs);
+}
+
+int main()
+{
+    Test_initIO();
+    TermWindow *w = Window_createWindow(101, 60, 200, 150, "canvas", WHITE);
+    Test_fills(w);
+    Test_shapes(w);
+    Test_fillRate(w);
+    return Test_result("test_canvas");
+}
@@ -0,0 +1,234 @@
+// Concurrency: tasks are host threads which really run in parallel, so this checks the window system's shared state
+// under windows being created and destroyed from several tasks, focus switching, racing dialogs and pipes between tasks.
+// It also measures how output from several tasks at once scales with their number.
+// Built once for the single-core kernel and once for the SMP kernel (test_concurrency_smp).
+
+#include <string.h>
+
+#include "test.h"
+
+#define CHURN_TASKS 6
+#define CHURN_ROUNDS 60
+#define DIALOG_TASKS 4
+#define DIALOG_ROUNDS 100
+#define PIPE_BYTES (256 * 1024)
+#define SCALING_LINES 400
+#define MAX_SCALING_TASKS 8
+
+static volatile uint finished;
+static volatile bool focusRunning;
+
+static void Test_done()
+{
+    __sync_fetch_and_add(&finished, 1);
+    vTaskSuspend(NULL);
+}
+
+static void Test_waitFinished(uint n)
+{
+    while (finished < n)
+        Window_delay(1);
+    finished = 0;
+}
+
+// Windows created, written to and destroyed from several tasks at once
+static void Test_churner(void *param)
+{
+    uint id = (uintptr_t)param;
+    for (int i = 0; i < CHURN_ROUNDS; i++)
+    {
+        TermWindow *w = Window_createWindow(20 + 100 * id, 40 + (i % 4) * 100, 90, 80, "churn", WHITE);
+        if (w == NULL)
+            continue;
+        Window_printf(w, "%u/%d\n", id, i);
+        Window_canvasFillRect(w, 0, 30, 90, 20, 1 + id % 7);
+        Window_destroy(w);
+    }
+    Test_done();
+}
+
+static void Test_focusSwitcher(void *param)
+{
+    while (focusRunning)
+    {
+        takeKeySemaphore();
+        Window_nextWindow();
+        giveKeySemaphore();
+        Window_taskYield();
+    }
+    Test_done();
+}
+
+static void Test_churn(TermWindow *own)
+{
+    focusRunning = true;
+    xTaskCreate(Test_focusSwitcher, "focus", WINDOW_TASK_STACK, NULL, 1, NULL);
+    for (uint i = 0; i < CHURN_TASKS; i++)
+        xTaskCreate(Test_churner, "churn", WINDOW_TASK_STACK, (void *)(uintptr_t)i, 1, NULL);
+    Test_waitFinished(CHURN_TASKS);
+    focusRunning = false;
+    Test_waitFinished(1);
+
+    // every window came back to the pool, and the focus is on one which exists
+    takeWindowsSemaphore();
+    CHECK(nrWindows == 1 && windowCarousel[0] == own);
+    CHECK(activeWindow == own);
+    giveWindowsSemaphore();
+    TermWindow *ws[MAX_WINDOWS];
+    uint n = 0;
+    while (n < MAX_WINDOWS && (ws[n] = Window_createWindow(0, 20, 60, 40, "pool", WHITE)) != NULL)
+        n++;
+    CHECK(n == MAX_WINDOWS - 1);
+    for (int i = 0; i < n; i++)
+        Window_destroy(ws[i]);
+}
+
+static volatile uint dialogsOpen, dialogOverlaps, dialogsOpened;
+
+static void Test_dialogOpener(void *param)
+{
+    uint id = (uintptr_t)param;
+    for (int i = 0; i < DIALOG_ROUNDS; i++)
+    {
+        TermWindow *d = Window_openDialog(100 + 40 * id, 100 + 20 * id, 120, 40, "modal", RED);
+        if (d == NULL)
+        {
+            Window_taskYield();
+            continue;
+        }
+        if (__sync_add_and_fetch(&dialogsOpen, 1) > 1)
+            __sync_fetch_and_add(&dialogOverlaps, 1);
+        __sync_fetch_and_add(&dialogsOpened, 1);
+        Window_printf(d, "dialog %u", id);
+        __sync_fetch_and_sub(&dialogsOpen, 1);
+        Window_closeDialog(d);
+    }
+    Test_done();
+}
+
+static void Test_dialogs()
+{
+    for (uint i = 0; i < DIALOG_TASKS; i++)
+        xTaskCreate(Test_dialogOpener, "dialog", WINDOW_TASK_STACK, (void *)(uintptr_t)i, 1, NULL);
+    Test_waitFinished(DIALOG_TASKS);
+    CHECK(dialogOverlaps == 0);
+    CHECK(dialogsOpened > 0);
+    CHECK(modalWindow == NULL);
+}
+
+static WindowPipe *pipes[2];
+static volatile uint pipeErrors;
+static volatile bool pipesGo;
+
+static uint8_t Test_byte(uint32_t i, uint pipe)
+{
+    return (i * 2654435761u >> 24) + pipe;
+}
+
+static void Test_pipeProducer(void *param)
+{
+    TermWindow *w = param;
+    uint id = w->name[4] - '0';
+    uint8_t chunk[113];
+    while (!pipesGo)
+        Window_taskYield();
+    for (uint32_t sent = 0; sent < PIPE_BYTES;)
+    {
+        uint n = (PIPE_BYTES - sent < sizeof(chunk)) ? PIPE_BYTES - sent : sizeof(chunk);
+        for (int i = 0; i < n; i++)
+            chunk[i] = Test_byte(sent + i, id);
+        sent += Window_pipeWrite(pipes[id], chunk, n, WINDOW_WAIT_FOREVER);
+    }
+    __sync_fetch_and_add(&finished, 1);
+    Window_exitTask(w);
+}
+
+static void Test_pipeConsumer(void *param)
+{
+    TermWindow *w = param;
+    uint id = w->name[4] - '0';
+    uint8_t buf[71];
+    while (!pipesGo)
+        Window_taskYield();
+    for (uint32_t received = 0; received < PIPE_BYTES;)
+    {
+        uint n = Window_pipeRead(pipes[id], buf, sizeof(buf), WINDOW_WAIT_FOREVER);
+        for (int i = 0; i < n; i++)
+            if (buf[i] != Test_byte(received + i, id))
+                __sync_fetch_and_add(&pipeErrors, 1);
+        received += n;
+    }
+    __sync_fetch_and_add(&finished, 1);
+    Window_exitTask(w);
+}
+
+// Two pipes, each between tasks pinned to different cores
+static void Test_pipes()
+{
+    char names[4][8] = {"prod0", "prod1", "cons0", "cons1"};
+    for (int i = 0; i < 2; i++)
+        pipes[i] = Window_createPipe(1000);
+    for (int i = 0; i < 4; i++)
+    {
+        TermWindow *w = Window_createWindow(10 + 150 * i, 300, 140, 60, names[i], WHITE);
+        CHECK(w != NULL && Window_startTask(w, i < 2 ? Test_pipeProducer : Test_pipeConsumer, names[i], WINDOW_TASK_STACK));
+        CHECK(Window_setCoreAffinity(w, 1 << (i % 2)) == (WINDOW_CORES > 1));
+    }
+    pipesGo = true;
+    Test_waitFinished(4);
+    // the windows of the tasks go once the render task has deleted them
+    while (nrWindows > 1)
+        Window_delay(1);
+    CHECK(pipeErrors == 0);
+    CHECK(Window_getPipeBytes(pipes[0]) == PIPE_BYTES && Window_getPipeBytes(pipes[1]) == PIPE_BYTES);
+}
+
+static void Test_writer(void *param)
+{
+    TermWindow *w = param;
+    for (int i = 0; i < SCALING_LINES; i++)
+        Window_printf(w, "line %d from a task writing to its own window\n", i);
+    Test_done();
+}
+
+// Output from n tasks at once, each into its own window
+static uint64_t Test_scalingRun(uint n)
+{
+    TermWindow *ws[MAX_SCALING_TASKS];
+    for (int i = 0; i < n; i++)
+        ws[i] = Window_createWindow(10 + (i % 4) * 156, 20 + (i / 4) * 230, 140, 200, "writer", WHITE);
+
+    uint64_t start = time_us_64();
+    for (int i = 0; i < n; i++)
+        xTaskCreate(Test_writer, "writer", WINDOW_TASK_STACK, ws[i], 1, NULL);
+    Test_waitFinished(n);
+    uint64_t elapsed = time_us_64() - start;
+
+    for (int i = 0; i < n; i++)
+        Window_destroy(ws[i]);
+    return elapsed;
+}
+
+static void Test_task(void *param)
+{
+    TermWindow *own = Window_createWindow(10, 420, 200, 40, "test", GREEN);
+    Test_churn(own);
+    Test_dialogs();
+    Test_pipes();
+
+    for (uint n = 1; n <= MAX_SCALING_TASKS; n *= 2)
+    {
+        uint64_t us = Test_scalingRun(n);
+        printf("benchmark,scaling,cores,%u,tasks,%u,lines,%u,elapsed_us,%u,klines_s,%.1f\n", WINDOW_CORES, n,
+               n * SCALING_LINES, (uint)us, n * SCALING_LINES * 1000.0 / us);
+    }
+
+    Test_exit(WINDOW_CORES > 1 ? "test_concurrency_smp" : "test_concurrency");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Destroying the window of another task: the task is never deleted where it stands, but ends itself at its next
+// read of input or check of Window_exitRequested. The stand-in kernel stops the test if a task is deleted while it
+// holds a semaphore or is in a critical section.
+
+#include "test.h"
+
+#define CYCLES 40
+
+static volatile uint loops;
+
+static void Test_reader(void *param)
+{
+    TermWindow *w = param;
+    char line[32];
+    while (true)
+    {
+        Window_readLine(w, line, sizeof(line));
+        loops++;
+    }
+}
+
+// Holds the key routing lock much of the time, as focus changes do, where deleting it would leave the lock taken
+static void Test_busy(void *param)
+{
+    TermWindow *w = param;
+    while (!Window_exitRequested(w))
+    {
+        takeKeySemaphore();
+        loops++;
+        Window_taskYield();
+        giveKeySemaphore();
+        Window_printf(w, "%u ", loops);
+    }
+    Window_exitTask(w);
+}
+
+static bool Test_shown(TermWindow *w)
+{
+    takeWindowsSemaphore();
+    bool shown = false;
+    for (int i = 0; i < nrWindows; i++)
+        shown |= windowCarousel[i] == w;
+    giveWindowsSemaphore();
+    return shown;
+}
+
+static TermWindow *Test_lastWindow()
+{
+    takeWindowsSemaphore();
+    TermWindow *w = windowCarousel[nrWindows - 1];
+    giveWindowsSemaphore();
+    return w;
+}
+
+// Destroys a task's window from this task, and waits for the task to have gone
+static bool Test_destroy(TaskFunction_t func)
+{
+    Window_createTaskWithWindow(func, 100, 100, 200, 100, "victim", WHITE);
+    TermWindow *w = Test_lastWindow();
+    loops = 0;
+    while (loops == 0 && func == Test_busy)
+        Window_taskYield();
+
+    Window_destroy(w);
+    for (int i = 0; i < 1000 && Test_shown(w); i++)
+        Window_delay(1);
+    return !Test_shown(w);
+}
+
+static void Test_task(void *param)
+{
+    TermWindow *own = Window_createWindow(400, 300, 200, 100, "test", GREEN);
+
+    for (int i = 0; i < CYCLES; i++)
+        CHECK(Test_destroy(Test_reader));
+    for (int i = 0; i < CYCLES; i++)
+        CHECK(Test_destroy(Test_busy));
+
+    // the pool slots all came back, and the remaining window still works
+    CHECK(nrWindows == 1 && windowCarousel[0] == own);
+    TermWindow *ws[MAX_WINDOWS];
+    uint n = 0;
+    while (n < MAX_WINDOWS - 1 && (ws[n] = Window_createWindow(0, 0, 60, 40, "pool", WHITE)) != NULL)
+        n++;
+    CHECK(n == MAX_WINDOWS - 1);
+    for (int i = 0; i < n; i++)
+        Window_destroy(ws[i]);
+    Window_printf(own, "done\n");
+
+    // with no windows left, switching focus finds nothing to switch to
+    Window_destroy(own);
+    CHECK(nrWindows == 0 && windowCarousel[0] == NULL);
+    takeKeySemaphore();
+    Window_nextWindow();
+    giveKeySemaphore();
+    CHECK(activeWindow == NULL);
+    TermWindow *last = Window_createWindow(400, 300, 200, 100, "last", GREEN);
+    takeKeySemaphore();
+    Window_nextWindow();
+    giveKeySemaphore();
+    CHECK(activeWindow == last);
+
+    Test_exit("test_destroy");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
@@ -0,0 +1,253 @@
+// Dialogs: only one can be open, also when tasks race to open one, frames which do not fit on the screen are refused,
+// and text, canvas and image drawing in the windows under a dialog leaves it alone, also while it is opening.
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+#include "window_pixel.h"
+
+#define RACE_ROUNDS 200
+#define DRAW_ROUNDS 20
+
+static uint8_t expected[TXCOUNT];
+static TermWindow *under;
+
+// Whether a screen pixel is in the frame of a dialog
+static bool Test_inDialog(TermWindow *d, int x, int y)
+{
+    return x >= d->xPos - 2 && x < d->xPos + (int)d->xRes + 2 && y >= d->yPos - 12 && y < d->yPos + (int)d->yRes + 2;
+}
+
+static bool Test_dialogUnchanged(TermWindow *d, const uint8_t *before)
+{
+    for (int y = d->yPos - 12; y < d->yPos + d->yRes + 2; y++)
+        for (int x = d->xPos - 2; x < d->xPos + d->xRes + 2; x++)
+            if (Pixel_get(before + FB_STRIDE * y, x) != Pixel_get(Pixel_row(y), x))
+                return false;
+    return true;
+}
+
+static void Test_waitFocus(TermWindow *d)
+{
+    while (!d->focusShown)
+        Window_taskYield();
+}
+
+static void Test_placement()
+{
+    CHECK(Window_openDialog(100, 5, 100, 50, "top", RED) == NULL);
+    CHECK(Window_openDialog(560, 100, 100, 50, "right", RED) == NULL);
+    CHECK(Window_openDialog(100, 400, 100, 100, "bottom", RED) == NULL);
+    StandIn_failMalloc(0);
+    CHECK(Window_openDialog(100, 100, 100, 50, "memory", RED) == NULL);
+    StandIn_failMalloc(-1);
+    CHECK(modalWindow == NULL);
+
+    // refusals leave no dialog claimed, and the largest frame fits
+    TermWindow *d = Window_openDialog(2, 10, FB_WIDTH - 6, FB_HEIGHT - 14, "whole", RED);
+    CHECK(d != NULL && modalWindow == d);
+    CHECK(Window_openDialog(100, 100, 100, 50, "second", RED) == NULL);
+    Window_closeDialog(d);
+    CHECK(modalWindow == NULL);
+}
+
+static volatile uint round, ready, opened;
+static TermWindow *volatile racers[2];
+
+static void Test_racer(void *param)
+{
+    uint id = (uintptr_t)param;
+    for (uint r = 1; r <= RACE_ROUNDS; r++)
+    {
+        while (round < r)
+            Window_taskYield();
+        racers[id] = Window_openDialog(100 + 20 * id, 100, 100, 50, "race", RED);
+        if (racers[id] != NULL)
+            __sync_fetch_and_add(&opened, 1);
+        __sync_fetch_and_add(&ready, 1);
+    }
+    vTaskSuspend(NULL);
+}
+
+static void Test_race()
+{
+    xTaskCreate(Test_racer, "racer0", WINDOW_TASK_STACK, (void *)0, 1, NULL);
+    xTaskCreate(Test_racer, "racer1", WINDOW_TASK_STACK, (void *)1, 1, NULL);
+
+    uint single = 0;
+    for (uint r = 1; r <= RACE_ROUNDS; r++)
+    {
+        opened = 0;
+        ready = 0;
+        round = r;
+        while (ready < 2)
+            Window_taskYield();
+        single += opened == 1;
+        for (int i = 0; i < 2; i++)
+            if (racers[i] != NULL)
+                Window_closeDialog(racers[i]);
+    }
+    CHECK(single == RACE_ROUNDS);
+    CHECK(modalWindow == NULL);
+}
+
+static void Test_referenceFill(TermWindow *d, uint8_t col)
+{
+    for (int y = under->yPos; y < under->yPos + under->yRes; y++)
+        for (int x = under->xPos; x < under->xPos + under->xRes; x++)
+            if (!Test_inDialog(d, x, y))
+                Pixel_set(expected + FB_STRIDE * y, x, col);
+}
+
+static void Test_referenceBlit(TermWindow *d, const WindowImage *img, int bx, int by, int transparent)
+{
+    for (int j = 0; j < img->height; j++)
+        for (int i = 0; i < img->width; i++)
+        {
+            uint8_t col = Pixel_get(img->data + FB_BYTES(img->width) * j, i);
+            int x = bx + i, y = by + j;
+            if (x >= 0 && y >= 0 && x < under->xRes && y < under->yRes && col != transparent &&
+                !Test_inDialog(d, under->xPos + x, under->yPos + y))
+                Pixel_set(expected + FB_STRIDE * (under->yPos + y), under->xPos + x, col);
+        }
+}
+
+static void Test_clipping()
+{
+    TermWindow *d = Window_openDialog(150, 120, 120, 60, "clip", RED);
+    Test_waitFocus(d);
+    memcpy(expected, vga_data_array, TXCOUNT);
+
+    Window_canvasFillRect(under, -5, -5, 1000, 1000, BLUE);
+    Test_referenceFill(d, BLUE);
+    CHECK(memcmp(expected, vga_data_array, TXCOUNT) == 0);
+
+    // every alignment of the image against the edges of the dialog, copied whole and transparent
+    static uint8_t data[FB_BYTES(121) * 47];
+    for (int i = 0; i < sizeof(data); i++)
+        data[i] = (i * 37) & 0x3F;
+    WindowImage img = {121, 47, data};
+    for (int x = 0; x < 4; x++)
+    {
+        int bx = d->xPos - under->xPos - 60 + x, by = d->yPos - under->yPos - 20;
+        Window_blit(under, &img, bx, by);
+        Test_referenceBlit(d, &img, bx, by, -1);
+        Window_blitTransparent(under, &img, bx + 100, by + 30, GREEN);
+        Test_referenceBlit(d, &img, bx + 100, by + 30, GREEN);
+    }
+    CHECK(memcmp(expected, vga_data_array, TXCOUNT) == 0);
+
+    // shapes drawn pixel by pixel
+    uint8_t before[TXCOUNT];
+    memcpy(before, vga_data_array, TXCOUNT);
+    Window_canvasLine(under, 0, 0, under->xRes - 1, under->yRes - 1, YELLOW);
+    Window_canvasCircle(under, 200, 120, 80, YELLOW);
+    Window_canvasFillCircle(under, 150, 100, 60, MAGENTA);
+    Window_canvasText(under, 100, 110, "hidden text", 2, WHITE);
+    for (int y = 0; y < under->yRes; y++)
+        for (int x = 0; x < under->xRes; x++)
+            Window_canvasPixel(under, x, y, (x + y) % 8);
+    CHECK(Test_dialogUnchanged(d, before));
+
+    Window_closeDialog(d);
+}
+
+static volatile bool drawing, pause, paused;
+
+// Waits while the test looks at the screen
+static void Test_drawerPause()
+{
+    if (pause)
+    {
+        paused = true;
+        while (pause)
+            Window_taskYield();
+        paused = false;
+    }
+}
+
+static void Test_canvasDrawer(void *param)
+{
+    for (uint8_t col = 0; drawing; col = (col + 1) % 8)
+    {
+        Test_drawerPause();
+        Window_canvasFillRect(under, 0, 0, under->xRes, under->yRes, col);
+        Window_taskYield();
+    }
+    vTaskSuspend(NULL);
+}
+
+static void Test_textDrawer(void *param)
+{
+    for (uint i = 0; drawing; i++)
+    {
+        Test_drawerPause();
+        Window_printf(under, "line %u of text written under dialogs %08x\n", i, i * 2654435761u);
+        if (i % 7 == 0)
+            Window_scrollLines(under, 2);
+    }
+    vTaskSuspend(NULL);
+}
+
+// Whether the text of a window on screen is what its cells hold
+static bool Test_textShown(TermWindow *w)
+{
+    static uint8_t shown[TXCOUNT];
+    memcpy(shown, vga_data_array, TXCOUNT);
+    for (int row = 0; row < w->term_rows; row++)
+        for (int col = 0; col < w->term_cols; col++)
+        {
+            WindowCell *cell = &w->cells[row * w->maxCols + col];
+            Window_drawGlyph(w, col, row, cell->c, cell->attr);
+        }
+    return memcmp(shown, vga_data_array, TXCOUNT) == 0;
+}
+
+// Dialogs opening and closing over a window which is drawn into all the time, by canvas calls or by text output
+static void Test_concurrentDrawing(TaskFunction_t drawer, bool text)
+{
+    drawing = true;
+    xTaskCreate(drawer, "drawer", WINDOW_TASK_STACK, NULL, 1, NULL);
+    static uint8_t before[TXCOUNT];
+    uint kept = 0, restored = 0;
+    for (int i = 0; i < DRAW_ROUNDS; i++)
+    {
+        TermWindow *d = Window_openDialog(150 + 2 * i, 120 + i, 120, 60, "busy", RED);
+        Test_waitFocus(d);
+        memcpy(before, vga_data_array, TXCOUNT);
+        Window_delay(5);
+        kept += Test_dialogUnchanged(d, before);
+        Window_closeDialog(d);
+
+        // once the dialog has gone, the text under it is whole again
+        pause = true;
+        while (!paused)
+            Window_taskYield();
+        restored += !text || Test_textShown(under);
+        pause = false;
+    }
+    drawing = false;
+    Window_delay(5);
+    CHECK(kept == DRAW_ROUNDS);
+    CHECK(restored == DRAW_ROUNDS);
+}
+
+static void Test_task(void *param)
+{
+    under = Window_createWindow(20, 40, 400, 240, "under", WHITE);
+    Test_placement();
+    Test_race();
+    Test_clipping();
+    Test_concurrentDrawing(Test_canvasDrawer, false);
+    Window_clear(under);
+    Test_concurrentDrawing(Test_textDrawer, true);
+    Test_exit("test_dialog");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Display backends which are pushed changed regions: damage is merged into few regions where that wastes little, and
+// every damaged pixel is pushed. Also reports the bytes per frame common workloads push, with the memory display.
+
+#include <string.h>
+
+#include "test.h"
+#include "window_pixel.h"
+
+#define WORKLOAD_FRAMES 50
+
+static WindowRect flushed[DISPLAY_MAX_REGIONS + 1];
+static uint nrFlushed;
+
+static uint Test_recordFlush(uint x, uint y, uint width, uint height)
+{
+    if (nrFlushed <= DISPLAY_MAX_REGIONS)
+        flushed[nrFlushed] = (WindowRect){x, y, width, height};
+    nrFlushed++;
+    return FB_BYTES(width) * height;
+}
+
+static const WindowDisplay recordingDisplay = {Test_recordFlush};
+
+static bool Test_covers(WindowRect *a, WindowRect *b)
+{
+    return a->x <= b->x && a->y <= b->y && a->x + a->width >= b->x + b->width && a->y + a->height >= b->y + b->height;
+}
+
+// Marks the given regions and flushes them. The render task flushes with the windows semaphore held, so it is kept out.
+// @return whether every region (clipped to the screen) is inside a pushed region which starts and ends on whole bytes
+static bool Test_flush(WindowRect *rs, uint n)
+{
+    takeWindowsSemaphore();
+    Window_flushDisplay();
+    nrFlushed = 0;
+    for (int i = 0; i < n; i++)
+        Window_markScreenDamage(rs[i].x, rs[i].y, rs[i].width, rs[i].height);
+    Window_flushDisplay();
+    giveWindowsSemaphore();
+
+    bool ok = nrFlushed <= DISPLAY_MAX_REGIONS;
+    for (int i = 0; i < nrFlushed && ok; i++)
+        ok = flushed[i].x % FB_PIXELS_PER_BYTE == 0 && flushed[i].width % FB_PIXELS_PER_BYTE == 0;
+    for (int i = 0; i < n && ok; i++)
+    {
+        WindowRect r = rs[i];
+        if (r.x < 0)
+            r.width += r.x, r.x = 0;
+        if (r.y < 0)
+            r.height += r.y, r.y = 0;
+        bool covered = false;
+        for (int j = 0; j < nrFlushed && !covered; j++)
+            covered = Test_covers(&flushed[j], &r);
+        ok = covered;
+    }
+    return ok;
+}
+
+static void Test_merging()
+{
+    Window_setDisplay(&recordingDisplay);
+
+    WindowRect adjacent[] = {{0, 0, 40, 10}, {40, 0, 40, 10}};
+    CHECK(Test_flush(adjacent, 2) && nrFlushed == 1);
+
+    WindowRect near[] = {{0, 100, 32, 8}, {40, 100, 32, 8}}; // 64 pixels wasted
+    CHECK(Test_flush(near, 2) && nrFlushed == 1);
+
+    WindowRect apart[] = {{0, 100, 32, 8}, {100, 100, 32, 8}}; // 544 pixels wasted
+    CHECK(Test_flush(apart, 2) && nrFlushed == 2);
+
+    WindowRect far[] = {{0, 0, 16, 16}, {400, 300, 16, 16}};
+    CHECK(Test_flush(far, 2) && nrFlushed == 2);
+
+    // a region joining two others merges all three
+    WindowRect bridged[] = {{0, 200, 64, 16}, {128, 200, 64, 16}, {64, 200, 64, 16}};
+    CHECK(Test_flush(bridged, 3) && nrFlushed == 1);
+
+    WindowRect unaligned[] = {{3, 50, 2, 1}};
+    CHECK(Test_flush(unaligned, 1) && nrFlushed == 1);
+
+    WindowRect offScreen[] = {{-10, -10, 30, 30}};
+    CHECK(Test_flush(offScreen, 1) && nrFlushed == 1 && flushed[0].x == 0 && flushed[0].y == 0);
+
+    // more regions than are kept: some grow to take in the rest
+    WindowRect many[12];
+    for (int i = 0; i < 12; i++)
+        many[i] = (WindowRect){(i % 4) * 160, (i / 4) * 160, 16, 16};
+    CHECK(Test_flush(many, 12) && nrFlushed == DISPLAY_MAX_REGIONS);
+}
+
+static uint32_t statFrames, statBytes;
+
+static void Test_startWorkload()
+{
+    Window_delay(2 * DISPLAY_FRAME_MS);
+    Window_getDisplayStats(&statFrames, &statBytes);
+}
+
+/// @return Bytes pushed per frame
+static uint Test_endWorkload(const char *name)
+{
+    Window_delay(2 * DISPLAY_FRAME_MS);
+    uint32_t frames, bytes;
+    Window_getDisplayStats(&frames, &bytes);
+    frames -= statFrames;
+    bytes -= statBytes;
+    printf("benchmark,display_%s,frames,%u,bytes,%u,bytes_per_frame,%u,full_screen_bytes,%u\n", name, (uint)frames, (uint)bytes,
+           frames ? (uint)(bytes / frames) : 0, FB_STRIDE * FB_HEIGHT);
+    return frames ? bytes / frames : 0;
+}
+
+static void Test_workloads()
+{
+    Window_setDisplay(&Window_memoryDisplay);
+    TermWindow *log = Window_createWindow(10, 20, 300, 440, "log", WHITE);
+    TermWindow *status = Window_createWindow(330, 20, 300, 100, "status", WHITE);
+
+    // a line of log output a frame, into a full window which scrolls
+    for (int i = 0; i < log->term_rows; i++)
+        Window_printf(log, "\n");
+    Test_startWorkload();
+    for (int i = 0; i < WORKLOAD_FRAMES; i++)
+    {
+        Window_printf(log, "%5d event from sensor %d\n", i, i % 3);
+        Window_delay(DISPLAY_FRAME_MS);
+    }
+    Test_endWorkload("log");
+
+    // a value updated in place
+    Test_startWorkload();
+    for (int i = 0; i < WORKLOAD_FRAMES; i++)
+    {
+        Window_setCursor(status, 8, 2);
+        Window_printf(status, "%5d", i * 17);
+        Window_delay(DISPLAY_FRAME_MS);
+    }
+    Test_endWorkload("status");
+
+    // a single key echoed
+    Test_startWorkload();
+    for (int i = 0; i < WORKLOAD_FRAMES; i++)
+    {
+        Window_write(status, 'a' + i % 26);
+        Window_delay(DISPLAY_FRAME_MS);
+    }
+    uint perFrame = Test_endWorkload("echo");
+    CHECK(perFrame > 0 && perFrame < FB_STRIDE * FB_HEIGHT / 100);
+
+    // both windows redrawn whole
+    Test_startWorkload();
+    for (int i = 0; i < WORKLOAD_FRAMES; i++)
+    {
+        Window_clear(log);
+        Window_clear(status);
+        Window_delay(DISPLAY_FRAME_MS);
+    }
+    Test_endWorkload("clear");
+}
+
+static void Test_task(void *param)
+{
+    Test_merging();
+    Test_workloads();
+    Test_exit("test_display");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
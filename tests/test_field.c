@@ -0,0 +1,86 @@
+// Dashboards: values are redrawn where they differ, and IDs of fields which do not exist are ignored.
+// Also measures the redraw cost of a 40-field dashboard, against printing every value over again.
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+
+#define BENCH_FIELDS 40
+#define BENCH_ROUNDS 500
+
+static void Test_benchmark()
+{
+    TermWindow *w = Window_createWindow(10, 20, 620, 440, "dashboard", WHITE);
+    WindowDashboard *d = Window_createDashboard(w, BENCH_FIELDS);
+    char label[16];
+    for (int i = 0; i < BENCH_FIELDS; i++)
+    {
+        snprintf(label, sizeof(label), "sensor %02d: ", i);
+        CHECK(Window_addField(d, (i % 2) * 38, i / 2, label, 10) == i);
+    }
+
+    // values which change in their last digits, as readings do
+    uint64_t start = time_us_64();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+        for (int i = 0; i < BENCH_FIELDS; i++)
+            Window_setField(d, i, "%d.%02d", 100 + i, (r * (i + 1)) % 100);
+    uint64_t fieldsUs = time_us_64() - start;
+
+    start = time_us_64();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+        for (int i = 0; i < BENCH_FIELDS; i++)
+        {
+            Window_setCursor(w, (i % 2) * 38 + 11, i / 2);
+            Window_printf(w, "%-10.10s", "");
+            Window_setCursor(w, (i % 2) * 38 + 11, i / 2);
+            Window_printf(w, "%d.%02d", 100 + i, (r * (i + 1)) % 100);
+        }
+    uint64_t printfUs = time_us_64() - start;
+
+    uint32_t updates, redrawn;
+    Window_getDashboardStats(d, &updates, &redrawn);
+    CHECK(updates == BENCH_FIELDS * BENCH_ROUNDS);
+    printf("benchmark,dashboard,fields,%u,rounds,%u,chars_redrawn_per_update,%.2f,field_us_per_round,%.1f,printf_us_per_round,%.1f\n",
+           BENCH_FIELDS, BENCH_ROUNDS, (double)redrawn / updates, (double)fieldsUs / BENCH_ROUNDS, (double)printfUs / BENCH_ROUNDS);
+    Window_destroy(w);
+}
+
+int main()
+{
+    Test_initIO();
+    TermWindow *w = Window_createWindow(100, 100, 200, 60, "fields", WHITE);
+    StandIn_failMalloc(0);
+    CHECK(Window_createDashboard(w, 2) == NULL);
+    StandIn_failMalloc(1);
+    CHECK(Window_createDashboard(w, 2) == NULL);
+    StandIn_failMalloc(-1);
+    WindowDashboard *d = Window_createDashboard(w, 2);
+
+    int temp = Window_addField(d, 0, 0, "Temp: ", 6);
+    int load = Window_addField(d, 0, 1, "Load: ", 4);
+    CHECK(temp == 0 && load == 1);
+    CHECK(Window_addField(d, 0, 2, "Full: ", 4) == -1);
+
+    CHECK(Window_setField(d, temp, "%d.%dC", 21, 5) == 5);
+    CHECK(Window_setField(d, temp, "%d.%dC", 21, 7) == 1);
+    CHECK(Window_setField(d, load, "%d%%", 50) == 3);
+
+    static uint8_t screen[TXCOUNT];
+    memcpy(screen, vga_data_array, TXCOUNT);
+    uint32_t updates, redrawn;
+    Window_getDashboardStats(d, &updates, &redrawn);
+
+    CHECK(!Window_setField(d, -1, "x"));
+    CHECK(!Window_setField(d, 2, "x"));
+    CHECK(!Window_setField(d, 1000000, "x"));
+    CHECK(memcmp(screen, vga_data_array, TXCOUNT) == 0);
+
+    uint32_t updatesAfter, redrawnAfter;
+    Window_getDashboardStats(d, &updatesAfter, &redrawnAfter);
+    CHECK(updatesAfter == updates && redrawnAfter == redrawn);
+
+    Test_benchmark();
+
+    return Test_result("test_field");
+}
@@ -0,0 +1,155 @@
+// Focus switching: keys typed while the focus switches, by Shift+Tab or by focus keys, all arrive, each in the window
+// which was in focus when it was typed. Focus keys switch straight to their window, are not sent to any window, are
+// ignored while a dialog is open and go away with their window.
+
+#include <string.h>
+
+#include "test.h"
+#include "ps2.h"
+
+#define SCRIPT_LEN 6000
+#define SOURCE_LEN 16
+#define KEY_A '['
+#define KEY_B ']'
+
+static TermWindow *a, *b;
+static char script[SCRIPT_LEN];
+static char expected[2][SCRIPT_LEN], received[2][SCRIPT_LEN];
+static uint expectedLen[2];
+static volatile uint receivedLen[2];
+static WindowInputSource source;
+
+static void Test_reader(void *param)
+{
+    TermWindow *w = param;
+    uint id = (w == b);
+    while (receivedLen[id] < expectedLen[id])
+    {
+        received[id][receivedLen[id]] = Window_getchar(w);
+        receivedLen[id]++;
+    }
+    vTaskSuspend(NULL);
+}
+
+// The key waiting in a window, 0 if there is none
+static char Test_key(TermWindow *w)
+{
+    char c = 0;
+    Window_tryGetchar(w, &c);
+    return c;
+}
+
+static void Test_setFocus(TermWindow *w)
+{
+    takeKeySemaphore();
+    Window_setActiveWindow(w);
+    giveKeySemaphore();
+}
+
+// Typing into two windows, switching between them every few keys by Shift+Tab or their focus keys
+static void Test_typingWhileSwitching()
+{
+    uint focus = 0;
+    for (int i = 0; i < SCRIPT_LEN; i++)
+    {
+        uint r = (i * 2654435761u) >> 24;
+        char c;
+        if (r % 7 == 0)
+        {
+            c = PS2_SHIFT_TAB;
+            focus = !focus;
+        }
+        else if (r % 7 == 1)
+        {
+            c = (r & 0x80) ? KEY_A : KEY_B;
+            focus = (c == KEY_B);
+        }
+        else
+        {
+            c = 'a' + r % 26;
+            expected[focus][expectedLen[focus]++] = c;
+        }
+        script[i] = c;
+    }
+
+    Test_setFocus(a);
+    Window_startTask(a, Test_reader, "readerA", WINDOW_TASK_STACK);
+    Window_startTask(b, Test_reader, "readerB", WINDOW_TASK_STACK);
+
+    // more keys than the windows' buffers hold, pushed by another task through a source which waits for room
+    Window_initHarnessInput(&source, "typing", SOURCE_LEN);
+    CHECK(Window_addInputSource(&source));
+    CHECK(Window_injectKeys(&source, script, SCRIPT_LEN, WINDOW_WAIT_FOREVER) == SCRIPT_LEN);
+    while (receivedLen[0] < expectedLen[0] || receivedLen[1] < expectedLen[1])
+        Window_delay(1);
+
+    for (int i = 0; i < 2; i++)
+        CHECK(memcmp(received[i], expected[i], expectedLen[i]) == 0);
+    uint32_t keys, delivered, dropped, stalls;
+    Window_getInputStats(&source, &keys, &delivered, &dropped, &stalls);
+    CHECK(keys == SCRIPT_LEN && delivered == expectedLen[0] + expectedLen[1] && dropped == 0);
+}
+
+static void Test_focusKeys()
+{
+    TermWindow *c = Window_createWindow(10, 250, 200, 100, "c", WHITE);
+    Test_setFocus(c);
+
+    // switches without reaching either window
+    Window_routeKey(KEY_A);
+    CHECK(activeWindow == a);
+    Window_routeKey(KEY_B);
+    CHECK(activeWindow == b);
+    CHECK(uxQueueMessagesWaiting(c->keyQueue) == 0);
+
+    // unbound, the key is typed like any other
+    Test_setFocus(c);
+    CHECK(Window_bindFocusKey(KEY_A, NULL));
+    Window_routeKey(KEY_A);
+    CHECK(activeWindow == c && Test_key(c) == KEY_A);
+
+    // rebinding moves the key to another window
+    CHECK(Window_bindFocusKey(KEY_B, c));
+    Test_setFocus(a);
+    Window_routeKey(KEY_B);
+    CHECK(activeWindow == c);
+
+    // a dialog keeps the focus
+    TermWindow *d = Window_openDialog(300, 300, 120, 40, "modal", RED);
+    Window_routeKey(KEY_B);
+    CHECK(activeWindow == d);
+    Window_closeDialog(d);
+
+    // the key goes with its window
+    Window_destroy(c);
+    Test_setFocus(a);
+    Window_routeKey(KEY_B);
+    CHECK(activeWindow == a);
+    CHECK(Test_key(a) == KEY_B);
+
+    // at most MAX_FOCUS_KEYS keys
+    for (int i = 0; i < MAX_FOCUS_KEYS; i++)
+        CHECK(Window_bindFocusKey('0' + i, a));
+    CHECK(!Window_bindFocusKey('z', a));
+    CHECK(Window_bindFocusKey('0', a)); // already bound to it
+}
+
+static void Test_task(void *param)
+{
+    a = Window_createWindow(10, 20, 300, 200, "a", WHITE);
+    b = Window_createWindow(330, 20, 300, 200, "b", WHITE);
+    CHECK(Window_bindFocusKey(KEY_A, a));
+    CHECK(Window_bindFocusKey(KEY_B, b));
+
+    Test_typingWhileSwitching();
+    Test_focusKeys();
+
+    Test_exit("test_focus");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
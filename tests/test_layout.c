@@ -0,0 +1,129 @@
+// Layouts: window frames fill their slots exactly and never overlap, before and after the layout changes, weights
+// out of range are clamped, and running out of memory while applying a layout changes nothing.
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+
+static uint8_t screen[TXCOUNT];
+
+static WindowRect Test_frame(TermWindow *w)
+{
+    return (WindowRect){w->xPos - 2, w->yPos - 12, w->xRes + 4, w->yRes + 14};
+}
+
+static bool Test_overlap(WindowRect a, WindowRect b)
+{
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+// Every window's frame is its slot, so the frames of a layout without empty slots tile its area
+static void Test_packed(WindowLayout *l)
+{
+    uint area = 0, misplaced = 0, overlaps = 0;
+    for (int i = 0; i < l->nrNodes; i++)
+    {
+        WindowLayoutNode *n = &l->nodes[i];
+        if (n->type != LAYOUT_SLOT)
+            continue;
+        WindowRect f = Test_frame(n->w);
+        misplaced += f.x != n->rect.x || f.y != n->rect.y || f.width != n->rect.width || f.height != n->rect.height;
+        area += f.width * f.height;
+        for (int j = i + 1; j < l->nrNodes; j++)
+            if (l->nodes[j].type == LAYOUT_SLOT)
+                overlaps += Test_overlap(f, Test_frame(l->nodes[j].w));
+    }
+    CHECK(misplaced == 0);
+    CHECK(overlaps == 0);
+    CHECK(area == l->area.width * l->area.height);
+}
+
+static void Test_idle(void *param)
+{
+    TermWindow *w = param;
+    while (true)
+        Window_getchar(w);
+}
+
+int main()
+{
+    Test_initIO();
+
+    WindowLayout l;
+    Window_initLayout(&l, 0, 0, FB_WIDTH, FB_HEIGHT);
+    int top = Window_addLayoutSplit(&l, LAYOUT_ROOT, LAYOUT_COLUMNS, 2);
+    int editor = Window_addLayoutSlot(&l, top, 2);
+    int monitor = Window_addLayoutSlot(&l, top, 1);
+    int grid = Window_addLayoutGrid(&l, LAYOUT_ROOT, 3, 2);
+    int cells[6];
+    for (int i = 0; i < 6; i++)
+        cells[i] = Window_addLayoutSlot(&l, grid, 1);
+    int console = Window_addLayoutSlot(&l, LAYOUT_ROOT, 1);
+
+    Window_createLayoutWindow(&l, editor, "editor", GREEN);
+    Window_createTaskWithLayout(Test_idle, &l, monitor, "monitor", YELLOW);
+    for (int i = 0; i < 6; i++)
+        Window_createLayoutWindow(&l, cells[i], "cell", WHITE);
+    Window_createLayoutWindow(&l, console, "console", CYAN);
+    Test_packed(&l);
+
+    TermWindow *mon = l.nodes[monitor].w;
+    CHECK(mon->task != NULL && mon->stackWords == WINDOW_TASK_STACK);
+
+    for (int i = 0; i < l.nrNodes; i++)
+        if (l.nodes[i].type == LAYOUT_SLOT)
+            Window_printf(l.nodes[i].w, "slot %d", i);
+
+    // new weights move and resize every window, keeping the text
+    Window_setLayoutWeight(&l, top, 1);
+    Window_setLayoutWeight(&l, grid, 3);
+    Window_setLayoutWeight(&l, editor, 1);
+    CHECK(Window_applyLayout(&l));
+    Test_packed(&l);
+    uint kept = 0;
+    for (int i = 0; i < l.nrNodes; i++)
+        if (l.nodes[i].type == LAYOUT_SLOT)
+        {
+            char expected[16];
+            snprintf(expected, sizeof(expected), "slot %d", i);
+            bool same = true;
+            for (int c = 0; expected[c]; c++)
+                same &= l.nodes[i].w->cells[c].c == expected[c];
+            kept += same;
+        }
+    CHECK(kept == 9);
+
+    // without memory for the resized text buffers, nothing moves
+    WindowRect before[MAX_LAYOUT_NODES];
+    for (int i = 0; i < l.nrNodes; i++)
+        if (l.nodes[i].type == LAYOUT_SLOT)
+            before[i] = Test_frame(l.nodes[i].w);
+    memcpy(screen, vga_data_array, TXCOUNT);
+    Window_setLayoutWeight(&l, top, 3);
+    StandIn_failMalloc(1);
+    CHECK(!Window_applyLayout(&l));
+    StandIn_failMalloc(-1);
+    uint moved = 0;
+    for (int i = 0; i < l.nrNodes; i++)
+        if (l.nodes[i].type == LAYOUT_SLOT)
+        {
+            WindowRect f = Test_frame(l.nodes[i].w);
+            moved += f.x != before[i].x || f.y != before[i].y || f.width != before[i].width || f.height != before[i].height;
+        }
+    CHECK(moved == 0);
+    CHECK(memcmp(screen, vga_data_array, TXCOUNT) == 0);
+    CHECK(Window_applyLayout(&l));
+    Test_packed(&l);
+
+    // weights past what a node holds are clamped, not wrapped
+    Window_setLayoutWeight(&l, top, 300);
+    Window_setLayoutWeight(&l, grid, 1000);
+    Window_setLayoutWeight(&l, console, 255);
+    CHECK(l.nodes[top].weight == 255 && l.nodes[grid].weight == 255);
+    CHECK(Window_applyLayout(&l));
+    CHECK(l.nodes[top].rect.height == l.nodes[grid].rect.height);
+    Test_packed(&l);
+
+    return Test_result("test_layout");
+}
@@ -0,0 +1,125 @@
+// Stress test of the shared output path: producer tasks log lines into one window as fast as they can,
+// and every line has to come out whole, in each producer's order, or be counted as dropped.
+// What the render task writes into the window is captured with a session trace.
+
+#include <string.h>
+
+#include "test.h"
+
+#define PRODUCERS 6
+#define LINES 4000
+#define TRACE_LEN (8 * 1024 * 1024)
+#define PADDING "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"
+
+static TermWindow *logWindow;
+static volatile int producersDone;
+static uint8_t trace[TRACE_LEN];
+
+// Lines of all lengths up to the longest a record holds
+static int Test_line(char *buf, int producer, int seq)
+{
+    int pad = (seq * 7 + producer * 13) % (LOG_LINE_LEN - 12);
+    return snprintf(buf, LOG_LINE_LEN, "p%d %05d %.*s", producer, seq, pad, PADDING);
+}
+
+static void producer(void *p)
+{
+    int id = (intptr_t)p;
+    char line[LOG_LINE_LEN];
+    for (int i = 0; i < LINES; i++)
+    {
+        Test_line(line, id, i);
+        Window_logLine(logWindow, "%s", line);
+        if (i % 16 == 0)
+            Window_delay(1);
+    }
+    __sync_fetch_and_add(&producersDone, 1);
+    vTaskSuspend(NULL);
+}
+
+static uint32_t Test_varint(const uint8_t *buf, uint *pos)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 32; shift += 7)
+    {
+        uint8_t b = buf[(*pos)++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    return v;
+}
+
+static void Test_checkLines(uint len)
+{
+    int next[PRODUCERS] = {0};
+    int received = 0;
+    char line[LOG_LINE_LEN + 1], expected[LOG_LINE_LEN];
+    int lineLen = 0;
+
+    for (uint pos = 2; pos < len;)
+    {
+        uint8_t header = trace[pos++];
+        Test_varint(trace, &pos);
+        uint32_t arg = Test_varint(trace, &pos);
+        if (header >> 4 != TRACE_WRITE || (header & 0x0F) != 0)
+            continue;
+
+        if (arg != '\n')
+        {
+            if (lineLen < LOG_LINE_LEN)
+                line[lineLen++] = arg;
+            continue;
+        }
+        line[lineLen] = 0;
+        lineLen = 0;
+
+        int producer, seq;
+        if (sscanf(line, "p%d %d", &producer, &seq) != 2 || producer < 0 || producer >= PRODUCERS)
+        {
+            fprintf(stderr, "mangled line: %s\n", line);
+            testFailures++;
+            continue;
+        }
+        Test_line(expected, producer, seq);
+        CHECK(strcmp(line, expected) == 0);
+        CHECK(seq >= next[producer]);
+        next[producer] = seq + 1;
+        received++;
+    }
+
+    uint32_t dropped = Window_getLogDropped(logWindow);
+    printf("test_log: %d lines shown, %u dropped\n", received, (uint)dropped);
+    CHECK(received + dropped == PRODUCERS * LINES);
+    CHECK(received > 0);
+}
+
+static void testTask(void *p)
+{
+    // the smallest ring still takes the longest line
+    TermWindow *small = Window_createWindow(400, 20, 200, 100, "small", WHITE);
+    Window_enableLog(small, 1);
+    Window_logLine(small, "%.*s", LOG_LINE_LEN - 1, PADDING PADDING);
+    CHECK(Window_getLogDropped(small) == 0);
+
+    Window_startTrace(trace, sizeof(trace));
+    for (int i = 0; i < PRODUCERS; i++)
+        xTaskCreate(producer, "producer", WINDOW_TASK_STACK, (void *)(intptr_t)i, 1, NULL);
+    while (producersDone < PRODUCERS)
+        Window_delay(1);
+    while (logWindow->log->tail != logWindow->log->head)
+        Window_delay(1);
+    uint len = Window_stopTrace();
+    CHECK(len + 64 < sizeof(trace));
+
+    Test_checkLines(len);
+    Test_exit("test_log");
+}
+
+int main()
+{
+    Test_initIO();
+    logWindow = Window_createWindow(20, 20, 360, 400, "log", WHITE);
+    Window_enableLog(logWindow, 16384);
+    Test_runTask(testTask, "test");
+}
@@ -0,0 +1,229 @@
+// Remote mirroring: the stream sent over stdio is captured and decoded into a copy of every window, which has to match
+// the windows once the mirror has caught up. Also measures the bytes per second a log workload needs, and checks
+// that the mirror keeps to its bandwidth and routes keys received from the remote side.
+
+#include <string.h>
+
+#include "test.h"
+
+#define MIRROR_BYTES_PER_S 11520 // 115200 baud
+#define WORKLOAD_MS 1000
+#define LINES_PER_S 40
+#define MIRROR_PERIOD_MS 50
+
+// Opcodes of the stream, as in window_mirror.c
+enum
+{
+    OP_SELECT = 1,
+    OP_SIZE,
+    OP_MOVE,
+    OP_ATTR,
+    OP_TEXT,
+    OP_REPEAT,
+    OP_SCROLL,
+    OP_CURSOR,
+    OP_FOCUS,
+    OP_SYNC
+};
+
+typedef struct RemoteWindow
+{
+    uint rows, cols;
+    WindowCell cells[64 * 128];
+    uint cursorRow, cursorCol;
+
+} RemoteWindow;
+
+static RemoteWindow remote[MAX_WINDOWS];
+static int remoteFocus = -1;
+static uint frames, badOps;
+
+static char *stream;
+static size_t streamLen;
+static FILE *console;
+
+static void Test_blank(RemoteWindow *r, uint from, uint to)
+{
+    for (uint i = from; i < to; i++)
+        r->cells[i] = (WindowCell){' ', WINDOW_ATTR(WHITE, BLACK)};
+}
+
+static void Test_put(RemoteWindow *r, uint *row, uint *col, uint8_t c, uint8_t attr)
+{
+    if (*row < r->rows && *col < r->cols)
+        r->cells[*row * r->cols + *col] = (WindowCell){c, attr};
+    else
+        badOps++;
+    (*col)++;
+}
+
+// Applies the stream from the start, as the remote side would
+static void Test_decode(const uint8_t *s, size_t len)
+{
+    RemoteWindow *r = NULL;
+    uint row = 0, col = 0;
+    uint8_t attr = 0;
+    frames = 0;
+    for (size_t i = 0; i < len;)
+    {
+        uint8_t op = s[i++];
+        if (op != OP_SELECT && op != OP_FOCUS && op != OP_SYNC && r == NULL)
+        {
+            badOps++;
+            return;
+        }
+        switch (op)
+        {
+        case OP_SELECT:
+            r = &remote[s[i++] % MAX_WINDOWS];
+            row = col = 0;
+            break;
+        case OP_SIZE:
+            r->rows = s[i];
+            r->cols = s[i + 1];
+            i += 2;
+            Test_blank(r, 0, r->rows * r->cols);
+            row = col = 0;
+            break;
+        case OP_MOVE:
+            row = s[i];
+            col = s[i + 1];
+            i += 2;
+            break;
+        case OP_ATTR:
+            attr = s[i++];
+            break;
+        case OP_TEXT:
+        {
+            uint n = s[i++];
+            for (uint j = 0; j < n; j++)
+                Test_put(r, &row, &col, s[i++], attr);
+            break;
+        }
+        case OP_REPEAT:
+        {
+            uint n = s[i];
+            for (uint j = 0; j < n; j++)
+                Test_put(r, &row, &col, s[i + 1], attr);
+            i += 2;
+            break;
+        }
+        case OP_SCROLL:
+        {
+            uint n = s[i++];
+            if (n > r->rows)
+                n = r->rows;
+            memmove(r->cells, r->cells + n * r->cols, (r->rows - n) * r->cols * sizeof(WindowCell));
+            Test_blank(r, (r->rows - n) * r->cols, r->rows * r->cols);
+            break;
+        }
+        case OP_CURSOR:
+            r->cursorRow = s[i];
+            r->cursorCol = s[i + 1];
+            i += 2;
+            break;
+        case OP_FOCUS:
+            remoteFocus = s[i++];
+            break;
+        case OP_SYNC:
+            frames++;
+            break;
+        default:
+            badOps++;
+            return;
+        }
+    }
+}
+
+// Whether the decoded copy of a window matches it
+static bool Test_matches(uint id)
+{
+    TermWindow *w = windowCarousel[id];
+    RemoteWindow *r = &remote[id];
+    if (r->rows != w->term_rows || r->cols != w->term_cols || r->cursorRow != w->currentRow || r->cursorCol != w->currentCol)
+        return false;
+    for (int row = 0; row < r->rows; row++)
+        for (int col = 0; col < r->cols; col++)
+        {
+            WindowCell a = r->cells[row * r->cols + col], b = w->cells[row * w->maxCols + col];
+            if (a.c != b.c || a.attr != b.attr)
+                return false;
+        }
+    return true;
+}
+
+// Waits until the mirror has had a whole frame without anything to send, and stops it from sending more while the
+// captured stream is looked at (it sends its frames with the windows semaphore held)
+static void Test_settle()
+{
+    uint32_t last;
+    do
+    {
+        last = Window_getMirrorBytesSent();
+        Window_delay(3 * MIRROR_PERIOD_MS);
+    } while (Window_getMirrorBytesSent() != last);
+    takeWindowsSemaphore();
+    fflush(stdout);
+}
+
+static void Test_task(void *param)
+{
+    TermWindow *logs = Window_createWindow(10, 20, 300, 200, "log", WHITE);
+    TermWindow *status = Window_createWindow(330, 20, 300, 200, "status", WHITE);
+    Window_enableLog(logs, 2048);
+
+    // the stream goes to a buffer in place of the console
+    console = stdout;
+    stdout = open_memstream(&stream, &streamLen);
+    Window_startMirror(MIRROR_BYTES_PER_S);
+
+    // a log workload: lines at a steady rate into one window, a status line updated in place in the other
+    uint32_t startBytes = Window_getMirrorBytesSent();
+    uint64_t start = time_us_64();
+    for (int i = 0; i < WORKLOAD_MS * LINES_PER_S / 1000; i++)
+    {
+        Window_logLine(logs, "%6d sensor %d reading %d.%02d", i, i % 4, (i * 37) % 100, (i * 53) % 100);
+        Window_setCursor(status, 0, 0);
+        Window_setTextColour(status, (i % 2) ? GREEN : YELLOW);
+        Window_printf(status, "lines logged: %d  ", i + 1);
+        Window_delay(1000 / LINES_PER_S);
+    }
+    uint64_t elapsedUs = time_us_64() - start;
+    uint32_t bytes = Window_getMirrorBytesSent() - startBytes;
+
+    // at most a frame's budget, and the frame marker, for each frame sent during the workload
+    uint maxFrames = elapsedUs / (MIRROR_PERIOD_MS * 1000) + 2;
+    CHECK(bytes <= maxFrames * (MIRROR_BYTES_PER_S * MIRROR_PERIOD_MS / 1000 + 1));
+
+    Test_settle();
+    Test_decode((const uint8_t *)stream, streamLen);
+    CHECK(badOps == 0);
+    CHECK(frames > 0);
+    CHECK(streamLen == Window_getMirrorBytesSent());
+    for (int i = 0; i < nrWindows; i++)
+        CHECK(Test_matches(i));
+    CHECK(remoteFocus >= 0 && windowCarousel[remoteFocus] == activeWindow);
+    giveWindowsSemaphore();
+
+    // keys from the remote side go to the window in focus
+    StandIn_pushStdio("ok", 2);
+    char keys[2];
+    keys[0] = Window_getchar(activeWindow == logs ? logs : status);
+    keys[1] = Window_getchar(activeWindow == logs ? logs : status);
+    CHECK(keys[0] == 'o' && keys[1] == 'k');
+
+    fclose(stdout);
+    stdout = console;
+    printf("benchmark,mirror_log,lines_per_s,%u,seconds,%.2f,bytes,%u,bytes_per_s,%.0f,frames,%u\n", LINES_PER_S,
+           elapsedUs / 1e6, (uint)bytes, bytes * 1e6 / elapsedUs, frames);
+    free(stream);
+
+    Test_exit("test_mirror");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
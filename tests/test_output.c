@@ -0,0 +1,61 @@
+// Text output: the cursor stays inside the window whatever it is set to, writes wrap and scroll at the edges,
+// and text sizes which cannot be set leave the window as it was
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+
+static uint8_t screen[TXCOUNT];
+
+// Nothing outside the window's content area may change
+static bool Test_onlyInside(TermWindow *w)
+{
+    for (int y = 0; y < FB_HEIGHT; y++)
+        for (int x = 0; x < FB_STRIDE; x++)
+        {
+            bool inside = y >= w->yPos && y < w->yPos + w->yRes && x >= w->xPos / 2 && x < (w->xPos + w->xRes) / 2;
+            if (!inside && screen[y * FB_STRIDE + x] != vga_data_array[y * FB_STRIDE + x])
+                return false;
+        }
+    return true;
+}
+
+int main()
+{
+    Test_initIO();
+    TermWindow *w = Window_createWindow(100, 100, 120, 80, "output", WHITE);
+    memcpy(screen, vga_data_array, TXCOUNT);
+    uint rows = Window_getRows(w), cols = Window_getCols(w);
+
+    Window_setCursor(w, cols + 5, rows + 5);
+    CHECK(w->currentCol == cols - 1 && w->currentRow == rows - 1);
+    Window_setCursor(w, -3, -1);
+    CHECK(w->currentCol == 0 && w->currentRow == 0);
+
+    // writing at the last cell of the last row wraps and scrolls
+    Window_setCursor(w, 1000, 1000);
+    Window_write(w, 'x');
+    CHECK(w->currentCol == 0 && w->currentRow == rows - 1);
+    CHECK(w->scrollCount == 1);
+
+    // a larger text size brings the cursor back inside the smaller text area
+    Window_setCursor(w, cols - 1, rows - 1);
+    Window_setTextSize(w, 3);
+    CHECK(w->currentCol < Window_getCols(w) && w->currentRow < Window_getRows(w));
+    Window_printf(w, "abcdefghijklmnopqrstuvwxyz");
+    Window_setTextSize(w, 1);
+
+    // without memory for the scaled glyphs, the text size stays as it was
+    StandIn_failMalloc(0);
+    Window_setTextSize(w, 5);
+    StandIn_failMalloc(-1);
+    CHECK(w->textSize == 1 && Window_getRows(w) == rows && Window_getCols(w) == cols);
+    Window_printf(w, "still drawn\n");
+
+    Window_setCursor(w, 1000, 0);
+    Window_printf(w, "0123456789012345678901234567890123456789\n");
+    CHECK(Test_onlyInside(w));
+
+    return Test_result("test_output");
+}
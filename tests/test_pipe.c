@@ -0,0 +1,90 @@
+// Pipes: a byte stream passed between two tasks arrives whole and in order, also across the wrap around of the
+// free-running counters, which needs the buffer size rounded up to a power of two. Also measures the throughput.
+
+#include <string.h>
+
+#include "test.h"
+
+#define STREAM_LEN (4 * 1024 * 1024)
+
+static WindowPipe *pipe;
+static volatile bool producerDone;
+
+static uint8_t Test_byte(uint32_t i)
+{
+    return (i * 2654435761u) >> 24;
+}
+
+static void Test_producer(void *param)
+{
+    uint8_t chunk[97];
+    uint32_t sent = 0;
+    while (sent < STREAM_LEN)
+    {
+        // alternately copied in and written in place, in sizes which do not divide the buffer
+        uint n = 1 + sent % 97;
+        if (n > STREAM_LEN - sent)
+            n = STREAM_LEN - sent;
+        if (sent % 2)
+        {
+            for (int i = 0; i < n; i++)
+                chunk[i] = Test_byte(sent + i);
+            sent += Window_pipeWrite(pipe, chunk, n, WINDOW_WAIT_FOREVER);
+        }
+        else
+        {
+            uint8_t *dst = Window_pipeReserve(pipe, &n, WINDOW_WAIT_FOREVER);
+            for (int i = 0; i < n; i++)
+                dst[i] = Test_byte(sent + i);
+            Window_pipeCommit(pipe, n);
+            sent += n;
+        }
+    }
+    producerDone = true;
+    vTaskSuspend(NULL);
+}
+
+static void Test_task(void *param)
+{
+    StandIn_failMalloc(1);
+    CHECK(Window_createPipe(64) == NULL);
+    StandIn_failMalloc(-1);
+
+    pipe = Window_createPipe(100);
+    CHECK(pipe != NULL && pipe->size == 128);
+    CHECK(Window_createPipe(0)->size == 1);
+
+    // close to the wrap around of the counters
+    pipe->head = pipe->tail = 0xFFFFFFFF - 1000;
+
+    uint64_t start = time_us_64();
+    xTaskCreate(Test_producer, "producer", WINDOW_TASK_STACK, NULL, 1, NULL);
+
+    uint8_t buf[61];
+    uint32_t received = 0, wrong = 0;
+    while (received < STREAM_LEN)
+    {
+        uint n = Window_pipeRead(pipe, buf, sizeof(buf), 1000);
+        if (n == 0)
+            break;
+        for (int i = 0; i < n; i++)
+            if (buf[i] != Test_byte(received + i))
+                wrong++;
+        received += n;
+    }
+    uint64_t elapsed = time_us_64() - start;
+
+    CHECK(received == STREAM_LEN);
+    CHECK(wrong == 0);
+    CHECK(Window_getPipeBytes(pipe) == STREAM_LEN);
+    CHECK(Window_pipeRead(pipe, buf, sizeof(buf), 0) == 0);
+    printf("benchmark,pipe,bytes,%u,elapsed_us,%u,mbyte_s,%.1f\n", STREAM_LEN, (uint)elapsed, (double)STREAM_LEN / elapsed);
+    Test_exit("test_pipe");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
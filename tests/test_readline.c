@@ -0,0 +1,125 @@
+// Line editor: keys routed to the window in focus are edited into the line as typed, with insertion and deletion at the
+// cursor, arrow movement, history recall and the length limit. Each key redraws only the cells which change, which is
+// counted in a session trace.
+
+#include <string.h>
+
+#include "test.h"
+
+#define TRACE_LEN (64 * 1024)
+
+static TermWindow *w;
+static uint8_t trace[TRACE_LEN];
+
+static void Test_keys(const char *keys)
+{
+    for (int i = 0; keys[i]; i++)
+        Window_routeKey(keys[i]);
+}
+
+// Reads a line typed as the given keys, ended with Enter
+static bool Test_line(const char *keys, uint len, const char *expected)
+{
+    char buf[64];
+    char enter[2] = {PS2_ENTER, 0};
+    Test_keys(keys);
+    Test_keys(enter);
+    uint n = Window_readLine(w, buf, len);
+    if (n != strlen(expected) || strcmp(buf, expected) != 0)
+    {
+        fprintf(stderr, "read \"%s\", expected \"%s\"\n", buf, expected);
+        return false;
+    }
+    return true;
+}
+
+static uint32_t Test_varint(uint *pos)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 32; shift += 7)
+    {
+        uint8_t b = trace[(*pos)++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    return v;
+}
+
+// Columns of the cells redrawn, in order
+static uint Test_cellsDrawn(uint len, uint8_t *cols, uint maxCols)
+{
+    uint n = 0;
+    for (uint pos = 2; pos < len;)
+    {
+        uint8_t header = trace[pos++];
+        Test_varint(&pos);
+        uint32_t arg = Test_varint(&pos);
+        if (header >> 4 == TRACE_CELL && n < maxCols)
+            cols[n++] = arg >> 16;
+    }
+    return n;
+}
+
+static void Test_task(void *param)
+{
+    w = Window_createWindow(10, 20, 400, 200, "editor", WHITE);
+    takeKeySemaphore();
+    Window_setActiveWindow(w);
+    giveKeySemaphore();
+
+    char left[2] = {PS2_LEFTARROW, 0}, right[2] = {PS2_RIGHTARROW, 0}, bs[2] = {PS2_BACKSPACE, 0};
+    char up[2] = {PS2_UPARROW, 0}, down[2] = {PS2_DOWNARROW, 0};
+    char keys[64];
+
+    CHECK(!Window_enableHistory(w, 0));
+    StandIn_failMalloc(1);
+    CHECK(!Window_enableHistory(w, 4));
+    StandIn_failMalloc(-1);
+    CHECK(w->history == NULL);
+    CHECK(Window_enableHistory(w, 4));
+
+    // typing, inserting in the middle, deleting before the cursor
+    CHECK(Test_line("hello", 64, "hello"));
+    snprintf(keys, sizeof(keys), "wrld%s%s%so", left, left, left);
+    CHECK(Test_line(keys, 64, "world"));
+    snprintf(keys, sizeof(keys), "abcd%s%s%s%s", bs, left, left, bs);
+    CHECK(Test_line(keys, 64, "bc"));
+    snprintf(keys, sizeof(keys), "ab%s%s%s%sc", left, left, right, right);
+    CHECK(Test_line(keys, 64, "abc"));
+
+    // history: the last line, further back up to the oldest of the 4 kept, and back down to what was being typed
+    CHECK(Test_line(up, 64, "abc"));
+    snprintf(keys, sizeof(keys), "%s%s", up, up);
+    CHECK(Test_line(keys, 64, "bc"));
+    snprintf(keys, sizeof(keys), "%s%s%s%s%s", up, up, up, up, up);
+    CHECK(Test_line(keys, 64, "world"));
+    snprintf(keys, sizeof(keys), "xy%s%s%s%s", up, up, down, down);
+    CHECK(Test_line(keys, 64, "xy"));
+    snprintf(keys, sizeof(keys), "%s%s!", up, bs);
+    CHECK(Test_line(keys, 64, "x!"));
+
+    // longer lines than the buffer holds stop at its end
+    CHECK(Test_line("abcdefgh", 6, "abcde"));
+
+    // redrawn cells: each character typed at the end redraws itself and the cursor after it, a move the two cells
+    // the cursor moves between, and an insertion the tail of the line from the new character on
+    Window_clear(w);
+    Window_startTrace(trace, TRACE_LEN);
+    snprintf(keys, sizeof(keys), "abcdefgh%s%s%s%sZ", left, left, left, left);
+    CHECK(Test_line(keys, 64, "abcdZefgh"));
+    uint8_t cols[64];
+    uint n = Test_cellsDrawn(Window_stopTrace(), cols, 64);
+    CHECK(n == 1 + 8 * 2 + 4 * 2 + 6 + 1);
+    for (int i = 0; i < 6 && n >= 7; i++)
+        CHECK(cols[n - 7 + i] == 4 + i);
+
+    Test_exit("test_readline");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Record log: records are formatted when drawn as printf would format them, with every kind of argument a record holds,
+// on the 64-bit host as well. Also compares what logging a record costs the producer against Window_printf.
+
+#include <string.h>
+
+#include "test.h"
+
+#define BENCH_LINES 2000
+
+static TermWindow *recWindow, *printWindow;
+
+// Text of a row of a window, without the trailing spaces
+static void Test_row(TermWindow *w, uint row, char *buf)
+{
+    uint len = 0;
+    for (int col = 0; col < w->term_cols; col++)
+        buf[len++] = w->cells[row * w->maxCols + col].c;
+    while (len && buf[len - 1] == ' ')
+        len--;
+    buf[len] = 0;
+}
+
+static void Test_waitDrawn(TermWindow *w)
+{
+    while (w->records->drawn != w->records->head)
+        Window_delay(1);
+}
+
+static void Test_formats()
+{
+    static const char *word = "words";
+    static int local;
+    char expected[8][LOG_LINE_LEN], row[128];
+
+    WINDOW_LOG_RECORD(recWindow, "no arguments");
+    WINDOW_LOG_RECORD(recWindow, "%d %i %u %x", -42, -7, 4000000000u, 0xBEEF);
+    WINDOW_LOG_RECORD(recWindow, "%s|%8s|%-6s|%.3s", "abc", word, "ab", word);
+    WINDOW_LOG_RECORD(recWindow, "%c%c %5d|%-5d|%05d", 'o', 'k', 12, -3, 77);
+    WINDOW_LOG_RECORD(recWindow, "%ld %lu %zu %lx", -123456789l, 3000000000ul, sizeof(WindowRecord), 0xCAFEul);
+    WINDOW_LOG_RECORD(recWindow, "%*d|%.*s|100%%", 6, 99, 2, "xyz");
+    WINDOW_LOG_RECORD(recWindow, "%p %s", &local, (const char *)NULL);
+    WINDOW_LOG_RECORD(recWindow, "%hd %hhu %o %X", (short)-5, (unsigned char)200, 8, 0xabc);
+
+    snprintf(expected[0], LOG_LINE_LEN, "no arguments");
+    snprintf(expected[1], LOG_LINE_LEN, "%d %i %u %x", -42, -7, 4000000000u, 0xBEEF);
+    snprintf(expected[2], LOG_LINE_LEN, "%s|%8s|%-6s|%.3s", "abc", word, "ab", word);
+    snprintf(expected[3], LOG_LINE_LEN, "%c%c %5d|%-5d|%05d", 'o', 'k', 12, -3, 77);
+    snprintf(expected[4], LOG_LINE_LEN, "%ld %lu %zu %lx", -123456789l, 3000000000ul, sizeof(WindowRecord), 0xCAFEul);
+    snprintf(expected[5], LOG_LINE_LEN, "%*d|%.*s|100%%", 6, 99, 2, "xyz");
+    snprintf(expected[6], LOG_LINE_LEN, "%p %s", (void *)&local, "(null)");
+    snprintf(expected[7], LOG_LINE_LEN, "%hd %hhu %o %X", (short)-5, (unsigned char)200, 8, 0xabc);
+
+    Test_waitDrawn(recWindow);
+    for (int i = 0; i < 8; i++)
+    {
+        Test_row(recWindow, i, row);
+        if (strcmp(row, expected[i]) != 0)
+            fprintf(stderr, "record %d: \"%s\", expected \"%s\"\n", i, row, expected[i]);
+        CHECK(strcmp(row, expected[i]) == 0);
+    }
+}
+
+// The time the producer spends, as the render task formats and draws the records later
+static void Test_producerCost()
+{
+    uint64_t start = time_us_64();
+    for (int i = 0; i < BENCH_LINES; i++)
+        WINDOW_LOG_RECORD(recWindow, "sample %d value %08x %s", i, i * 2654435761u, "bench");
+    uint64_t recordUs = time_us_64() - start;
+    Test_waitDrawn(recWindow);
+
+    start = time_us_64();
+    for (int i = 0; i < BENCH_LINES; i++)
+        Window_printf(printWindow, "sample %d value %08x %s\n", i, i * 2654435761u, "bench");
+    uint64_t printfUs = time_us_64() - start;
+
+    printf("benchmark,record_producer,lines,%u,record_us,%u,printf_us,%u\n", BENCH_LINES, (uint)recordUs, (uint)printfUs);
+}
+
+static void Test_task(void *param)
+{
+    recWindow = Window_createWindow(10, 20, 400, 200, "records", WHITE);
+    printWindow = Window_createWindow(10, 250, 400, 200, "printf", WHITE);
+    Window_enableRecordLog(recWindow, 64);
+
+    Test_formats();
+    Test_producerCost();
+
+    Test_exit("test_record");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
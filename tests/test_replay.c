@@ -0,0 +1,116 @@
+// Session traces: a session in two windows, one of them written from another task, is recorded with its task switches
+// and replayed onto the same windows, which must end up with the same screen
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+
+#define TRACE_LEN 65536
+#define WORKER_LINES 200
+
+static uint8_t trace[TRACE_LEN];
+static volatile bool workerDone;
+
+static void Test_createWindows(TermWindow **a, TermWindow **b)
+{
+    *a = Window_createWindow(10, 20, 300, 200, "session", WHITE);
+    *b = Window_createWindow(330, 20, 300, 200, "worker", GREEN);
+}
+
+// Waits for the render task to show focus, which the checksum includes
+static void Test_settle()
+{
+    while (activeWindow == NULL || !activeWindow->focusShown)
+        Window_taskYield();
+    Window_delay(20);
+}
+
+static void Test_worker(void *param)
+{
+    TermWindow *w = param;
+    for (int i = 0; i < WORKER_LINES; i++)
+    {
+        Window_printf(w, "line %d\n", i);
+        if (i % 8 == 0)
+            Window_delay(1);
+    }
+    workerDone = true;
+    vTaskSuspend(NULL);
+}
+
+static void Test_session(TermWindow *w)
+{
+    for (int i = 0; i < 40; i++)
+    {
+        Window_setTextColour(w, 1 + i % 7);
+        Window_printf(w, "session %d ", i);
+        if (i % 5 == 0)
+            Window_delay(1);
+    }
+    Window_setCursor(w, 3, 4);
+    Window_setTextAttributes(w, ATTR_INVERSE);
+    Window_printf(w, "inverse");
+    Window_setTextAttributes(w, 0);
+    Window_scrollLines(w, 3);
+    Window_clear(w);
+    Window_setTextSize(w, 2);
+    Window_printf(w, "large text\nafter the clear");
+}
+
+static bool Test_hasTaskSwitches(uint len)
+{
+    uint n = 0;
+    for (uint pos = 2; pos < len;)
+    {
+        uint8_t type = trace[pos++] >> 4;
+        for (int field = 0; field < 2; field++)
+            while (pos < len && (trace[pos++] & 0x80))
+                ;
+        if (type == TRACE_TASK)
+            n++;
+    }
+    return n > 0;
+}
+
+static void Test_task(void *param)
+{
+    TermWindow *a, *b;
+    Test_createWindows(&a, &b);
+    Test_settle();
+
+    Window_startTrace(trace, TRACE_LEN);
+    xTaskCreate(Test_worker, "worker", WINDOW_TASK_STACK, b, 1, NULL);
+    Test_session(a);
+    while (!workerDone)
+        Window_delay(1);
+    uint len = Window_stopTrace();
+    Test_settle();
+    uint32_t recorded = Window_screenChecksum();
+
+    CHECK(len > 2 && len < TRACE_LEN);
+    CHECK(Test_hasTaskSwitches(len));
+
+    Window_destroy(b);
+    Window_destroy(a);
+    VGA_fillScreen(BLACK);
+    Test_createWindows(&a, &b);
+    Test_settle();
+
+    WindowReplayResult res;
+    CHECK(Window_replayTrace(trace, len, false, &res));
+    Test_settle();
+    CHECK(res.replayed > WORKER_LINES);
+    CHECK(Window_screenChecksum() == recorded);
+
+    printf("benchmark,replay,events,%u,replayed,%u,elapsed_us,%u,busy_us,%u\n", (uint)res.events, (uint)res.replayed,
+           (uint)res.elapsedUs, (uint)res.busyUs);
+    Test_exit("test_replay");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
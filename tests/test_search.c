@@ -0,0 +1,151 @@
+// Search: Window_search, with its word-at-a-time scan for the first character, must find the same matches as a plain
+// scan of the cells, for every alignment of the rows and for characters with the top bit set.
+// Also measures searching a screen full of windows.
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+
+#define SEARCH_ROUNDS 300
+#define MAX_MATCHES 64
+
+static const char alphabet[] = "abc \xB0";
+
+static uint32_t seed = 1;
+
+static uint Test_random(uint n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % n;
+}
+
+static void Test_fill(TermWindow *w, uint letters)
+{
+    for (int row = 0; row < w->term_rows; row++)
+        for (int col = 0; col < w->term_cols; col++)
+            Window_putCell(w, col, row, alphabet[Test_random(letters)], WINDOW_ATTR(WHITE, BLACK));
+}
+
+// Leftmost, non-overlapping matches within each row
+static uint Test_naiveSearch(TermWindow *w, const char *pattern, WindowMatch *matches, uint maxMatches)
+{
+    uint len = strlen(pattern), found = 0;
+    for (uint row = 0; row < w->term_rows && len; row++)
+        for (uint col = 0; col + len <= w->term_cols && found < maxMatches;)
+        {
+            const WindowCell *cells = w->cells + row * w->maxCols + col;
+            uint i = 0;
+            while (i < len && cells[i].c == pattern[i])
+                i++;
+            if (i == len)
+            {
+                matches[found++] = (WindowMatch){row, col, len};
+                col += len;
+            }
+            else
+                col++;
+        }
+    return found;
+}
+
+static bool Test_sameMatches(const WindowMatch *a, const WindowMatch *b, uint n)
+{
+    for (int i = 0; i < n; i++)
+        if (a[i].row != b[i].row || a[i].col != b[i].col || a[i].len != b[i].len)
+            return false;
+    return true;
+}
+
+static void Test_compare(TermWindow *w)
+{
+    WindowMatch got[MAX_MATCHES], want[MAX_MATCHES];
+    uint mismatches = 0;
+    for (int round = 0; round < SEARCH_ROUNDS; round++)
+    {
+        if (round % 20 == 0)
+            Test_fill(w, 2 + round / 20 % 4);
+
+        char pattern[5] = {0};
+        uint len = 1 + Test_random(4);
+        for (int i = 0; i < len; i++)
+            pattern[i] = alphabet[Test_random(sizeof(alphabet) - 1)];
+        uint maxMatches = 1 + Test_random(MAX_MATCHES);
+
+        uint n = Window_search(w, pattern, got, maxMatches);
+        if (n != Test_naiveSearch(w, pattern, want, maxMatches) || !Test_sameMatches(got, want, n))
+            mismatches++;
+    }
+    CHECK(mismatches == 0);
+    CHECK(Window_search(w, "", got, MAX_MATCHES) == 0);
+}
+
+// Highlights of a window in an update are drawn when it ends, as they are drawn outside of one
+static void Test_highlightInUpdate()
+{
+    static uint8_t plain[TXCOUNT], highlighted[TXCOUNT];
+    TermWindow *w = Window_createWindow(100, 100, 200, 100, "update", WHITE);
+    Window_printf(w, "find abc and abc\nabc again");
+
+    memcpy(plain, vga_data_array, TXCOUNT);
+    CHECK(Window_highlight(w, "abc") == 3);
+    memcpy(highlighted, vga_data_array, TXCOUNT);
+    CHECK(memcmp(plain, highlighted, TXCOUNT) != 0);
+    Window_clearHighlight(w);
+    CHECK(memcmp(plain, vga_data_array, TXCOUNT) == 0);
+
+    Window_beginUpdate(w);
+    CHECK(Window_highlight(w, "abc") == 3);
+    CHECK(memcmp(plain, vga_data_array, TXCOUNT) == 0);
+    Window_endUpdate(w);
+    CHECK(memcmp(highlighted, vga_data_array, TXCOUNT) == 0);
+
+    Window_beginUpdate(w);
+    Window_clearHighlight(w);
+    CHECK(memcmp(highlighted, vga_data_array, TXCOUNT) == 0);
+    Window_endUpdate(w);
+    CHECK(memcmp(plain, vga_data_array, TXCOUNT) == 0);
+
+    Window_destroy(w);
+}
+
+int main()
+{
+    Test_initIO();
+
+    // odd numbers of columns start every other row on half a word
+    TermWindow *even = Window_createWindow(0, 20, 240, 200, "even", WHITE);
+    TermWindow *odd = Window_createWindow(250, 20, 246, 200, "odd", WHITE);
+    CHECK(even->maxCols % 2 == 0 && odd->maxCols % 2 == 1);
+    Test_compare(even);
+    Test_compare(odd);
+    Window_destroy(even);
+    Window_destroy(odd);
+    Test_highlightInUpdate();
+
+    // a screen full of windows full of text, with the word found once at the end of each
+    TermWindow *ws[10];
+    for (int i = 0; i < 10; i++)
+    {
+        ws[i] = Window_createWindow(4 + (i % 5) * 127, 10 + (i / 5) * 235, 120, 220, "full", WHITE);
+        Test_fill(ws[i], 4);
+        Window_putCell(ws[i], ws[i]->term_cols - 1, ws[i]->term_rows - 1, 'z', WINDOW_ATTR(WHITE, BLACK));
+    }
+
+    WindowMatch m[MAX_MATCHES];
+    uint found = 0;
+    uint32_t start = time_us_32();
+    for (int i = 0; i < 10; i++)
+        found += Window_search(ws[i], "z", m, MAX_MATCHES);
+    uint32_t searchUs = time_us_32() - start;
+    start = time_us_32();
+    for (int i = 0; i < 10; i++)
+        Test_naiveSearch(ws[i], "z", m, MAX_MATCHES);
+    uint32_t naiveUs = time_us_32() - start;
+    CHECK(found == 10);
+
+    uint cells = 10 * ws[0]->term_rows * ws[0]->term_cols;
+    printf("benchmark,search_screen,windows,10,cells,%u,search_us,%u,naive_us,%u\n", cells, (uint)searchUs, (uint)naiveUs);
+
+    return Test_result("test_search");
+}
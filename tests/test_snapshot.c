@@ -0,0 +1,208 @@
+// Golden-image regression harness: runs scripted window scenarios, and compares snapshots of the screen
+// to the images stored in golden/. Run with WINDOW_UPDATE_GOLDEN=1 to store new images after a deliberate change of the output.
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+#include "gfx.h"
+
+#define SNAPSHOT_BUF_LEN (TXCOUNT + TXCOUNT / 64 + 64)
+
+static uint8_t snapshot[SNAPSHOT_BUF_LEN];
+static uint8_t screen[TXCOUNT];
+
+typedef struct Scenario
+{
+    const char *name;
+    void (*run)(TermWindow *ws[]);
+    uint windows;
+
+} Scenario;
+
+static void Scenario_windows(TermWindow *ws[])
+{
+    for (int i = 0; i < 3; i++)
+        Window_printf(ws[i], "Window %d\nsome text in it\n", i);
+}
+
+static void Scenario_scroll(TermWindow *ws[])
+{
+    for (int i = 0; i < 40; i++)
+        Window_printf(ws[0], "line %d of the scroll test\n", i);
+    Window_scrollLines(ws[1], 0);
+    Window_printString(ws[1], "no scroll\n");
+}
+
+static void Scenario_clear(TermWindow *ws[])
+{
+    Window_printf(ws[0], "this is cleared away\n");
+    Window_clear(ws[0]);
+    Window_printf(ws[0], "after the clear\n");
+    Window_printf(ws[1], "left alone\n");
+}
+
+static void Scenario_focus(TermWindow *ws[])
+{
+    Window_drawFocus();
+    Window_setActiveWindow(ws[0]);
+    Window_drawFocus();
+    Window_printf(ws[0], "in focus\n");
+}
+
+static void Scenario_text(TermWindow *ws[])
+{
+    Window_setTextSize(ws[0], 2);
+    Window_setTextColour(ws[0], YELLOW);
+    Window_printf(ws[0], "big\n");
+    Window_setTextSize(ws[0], 1);
+    Window_setBackgroundColour(ws[0], BLUE);
+    Window_setTextAttributes(ws[0], ATTR_UNDERLINE);
+    Window_printf(ws[0], "underlined on blue\n");
+    Window_setTextAttributes(ws[0], ATTR_INVERSE);
+    Window_setCursor(ws[0], 5, 6);
+    Window_printf(ws[0], "inverse");
+}
+
+static const Scenario scenarios[] = {
+    {"windows", Scenario_windows, 3},
+    {"scroll", Scenario_scroll, 2},
+    {"clear", Scenario_clear, 2},
+    {"focus", Scenario_focus, 2},
+    {"text", Scenario_text, 1},
+};
+
+static bool Golden_compare(const char *name, const uint8_t *buf, uint len)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "golden/%s.snap", name);
+
+    if (getenv("WINDOW_UPDATE_GOLDEN") != NULL)
+    {
+        FILE *f = fopen(path, "wb");
+        if (f == NULL)
+            return false;
+        fwrite(buf, 1, len, f);
+        fclose(f);
+        return true;
+    }
+
+    static uint8_t golden[SNAPSHOT_BUF_LEN];
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "%s: no golden image\n", path);
+        return false;
+    }
+    uint goldenLen = fread(golden, 1, sizeof(golden), f);
+    fclose(f);
+    if (goldenLen != len || memcmp(golden, buf, len))
+    {
+        fprintf(stderr, "%s: screen differs from the golden image\n", path);
+        return false;
+    }
+    return true;
+}
+
+static void Test_scenario(const Scenario *s)
+{
+    TermWindow *ws[3];
+    VGA_fillScreen(BLACK);
+    for (int i = 0; i < s->windows; i++)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "%s %d", s->name, i);
+        ws[i] = Window_createWindow(20 + 200 * i, 30 + 40 * i, 180, 200, name, (i % 2) ? CYAN : WHITE);
+    }
+    s->run(ws);
+
+    uint len = Window_snapshotScreen(snapshot, sizeof(snapshot));
+    CHECK(len != 0);
+    CHECK(Golden_compare(s->name, snapshot, len));
+
+    // the snapshot brings back exactly what was on screen
+    memcpy(screen, vga_data_array, TXCOUNT);
+    VGA_fillScreen(RED);
+    CHECK(Window_restoreSnapshot(snapshot, len));
+    CHECK(memcmp(screen, vga_data_array, TXCOUNT) == 0);
+
+    // and so does the snapshot of a window, over its own rectangle
+    len = Window_snapshotWindow(ws[0], snapshot, sizeof(snapshot));
+    CHECK(len != 0);
+    Window_clear(ws[0]);
+    CHECK(Window_restoreSnapshot(snapshot, len));
+    CHECK(memcmp(screen, vga_data_array, TXCOUNT) == 0);
+
+    for (int i = 0; i < s->windows; i++)
+        Window_destroy(ws[i]);
+}
+
+static void Test_putWord(uint8_t *buf, uint v)
+{
+    buf[0] = v & 0xFF;
+    buf[1] = v >> 8;
+}
+
+static void Test_malformed()
+{
+    VGA_fillScreen(GREEN);
+    memcpy(screen, vga_data_array, TXCOUNT);
+
+    // a rectangle of 4 bytes by 2 rows, all white, as one packet
+    uint8_t s[] = {'S', 0, 0, 0, 0, 4, 0, 2, 0, 0x80 | 7, 0x3F};
+    Test_putWord(s + 1, 10);
+    Test_putWord(s + 3, 20);
+    CHECK(Window_restoreSnapshot(s, sizeof(s)));
+    CHECK(vga_data_array[20 * FB_STRIDE + 10] == 0x3F && vga_data_array[21 * FB_STRIDE + 13] == 0x3F);
+    VGA_fillScreen(GREEN);
+
+    // past the right edge of the screen
+    Test_putWord(s + 1, FB_STRIDE - 2);
+    CHECK(!Window_restoreSnapshot(s, sizeof(s)));
+    // past the bottom
+    Test_putWord(s + 1, 10);
+    Test_putWord(s + 3, FB_HEIGHT - 1);
+    CHECK(!Window_restoreSnapshot(s, sizeof(s)));
+    // empty rectangle
+    Test_putWord(s + 3, 20);
+    Test_putWord(s + 5, 0);
+    CHECK(!Window_restoreSnapshot(s, sizeof(s)));
+    // packets covering only part of the rectangle, which is not drawn either
+    Test_putWord(s + 5, 8);
+    CHECK(!Window_restoreSnapshot(s, sizeof(s)));
+    // truncated packet
+    Test_putWord(s + 5, 4);
+    uint8_t t[] = {'S', 10, 0, 20, 0, 4, 0, 2, 0, 0x80 | 3, 0x3F, 3, 1, 2};
+    CHECK(!Window_restoreSnapshot(t, sizeof(t)));
+
+    CHECK(memcmp(screen, vga_data_array, TXCOUNT) == 0);
+}
+
+static void Test_clipping()
+{
+    VGA_fillScreen(BLACK);
+    GFX_fillRect(600, 400, 40, 80, MAGENTA);
+    memcpy(screen, vga_data_array, TXCOUNT);
+
+    // the part off screen is left out
+    uint len = Window_snapshotRect(600, 400, 100, 200, snapshot, sizeof(snapshot));
+    CHECK(len != 0);
+    CHECK(snapshot[5] == 20 && snapshot[7] == 80);
+    VGA_fillScreen(BLACK);
+    CHECK(Window_restoreSnapshot(snapshot, len));
+    CHECK(memcmp(screen, vga_data_array, TXCOUNT) == 0);
+
+    CHECK(Window_snapshotRect(FB_WIDTH, 0, 10, 10, snapshot, sizeof(snapshot)) == 0);
+    CHECK(Window_snapshotRect(0, FB_HEIGHT, 10, 10, snapshot, sizeof(snapshot)) == 0);
+    CHECK(Window_snapshotRect(0, 0, 10, 10, snapshot, 4) == 0);
+}
+
+int main()
+{
+    Test_initIO();
+    for (int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        Test_scenario(&scenarios[i]);
+    Test_malformed();
+    Test_clipping();
+    return Test_result("test_snapshot");
+}
@@ -0,0 +1,82 @@
+// Input sources: a pasted blob much longer than a window's key buffer arrives whole and in order, from a replay source
+// and from a harness source which another task pushes into, while the window reads slower than the keys come in.
+// Also measures the key throughput of each.
+
+#include <string.h>
+
+#include "test.h"
+
+#define BLOB_LEN 20000
+#define HARNESS_LEN 16
+#define SLOW_EVERY 500 // the reader pauses after this many keys
+
+static TermWindow *w;
+static char blob[BLOB_LEN];
+static WindowInputSource replay, harness;
+
+// Reads the blob back from the window
+static bool Test_readBlob()
+{
+    uint wrong = 0;
+    for (int i = 0; i < BLOB_LEN; i++)
+    {
+        if (Window_getchar(w) != blob[i])
+            wrong++;
+        if (i % SLOW_EVERY == 0)
+            Window_delay(1);
+    }
+    return wrong == 0;
+}
+
+static void Test_injector(void *param)
+{
+    for (uint sent = 0; sent < BLOB_LEN;)
+        sent += Window_injectKeys(&harness, blob + sent, (BLOB_LEN - sent < 100) ? BLOB_LEN - sent : 100, WINDOW_WAIT_FOREVER);
+    vTaskSuspend(NULL);
+}
+
+static void Test_checkStats(WindowInputSource *s, const char *name, uint64_t us)
+{
+    uint32_t received, delivered, dropped, stalls;
+    Window_getInputStats(s, &received, &delivered, &dropped, &stalls);
+    CHECK(received == BLOB_LEN);
+    CHECK(delivered == received);
+    CHECK(dropped == 0);
+    CHECK(stalls > 0); // the key buffer filled up, and the source waited
+    printf("benchmark,input_%s,keys,%u,stalls,%u,elapsed_us,%u,keys_per_s,%.0f\n", name, (uint)delivered, (uint)stalls, (uint)us,
+           delivered * 1e6 / us);
+}
+
+static void Test_task(void *param)
+{
+    w = Window_createWindow(10, 20, 400, 200, "paste", WHITE);
+    takeKeySemaphore();
+    Window_setActiveWindow(w);
+    giveKeySemaphore();
+    for (int i = 0; i < BLOB_LEN; i++)
+        blob[i] = "abcdefghijklmnopqrstuvwxyz0123456789 ,.;"[(i * 7 + i / 40) % 40];
+
+    // a script kept in memory
+    Window_initReplayInput(&replay, "replay", blob, BLOB_LEN);
+    uint64_t start = time_us_64();
+    CHECK(Window_addInputSource(&replay));
+    CHECK(Test_readBlob());
+    Test_checkStats(&replay, "replay", time_us_64() - start);
+
+    // keys pushed by another task into a source which holds fewer of them than the window's buffer
+    Window_initHarnessInput(&harness, "harness", HARNESS_LEN);
+    CHECK(Window_addInputSource(&harness));
+    start = time_us_64();
+    xTaskCreate(Test_injector, "inject", WINDOW_TASK_STACK, NULL, 1, NULL);
+    CHECK(Test_readBlob());
+    Test_checkStats(&harness, "harness", time_us_64() - start);
+
+    Test_exit("test_source");
+}
+
+int main()
+{
+    Test_initIO();
+    Test_runTask(Test_task, "test");
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Update batching: output inside Window_beginUpdate/Window_endUpdate only changes the stored cells, nothing is drawn
+// until the outermost update ends, and then the window looks exactly as if the output had been drawn right away.
+// Also measures a status panel repaint with and without batching.
+
+#include <string.h>
+
+#include "test.h"
+#include "vga.h"
+
+#define PANEL_ROWS 12
+#define PANEL_RUNS 200
+
+static uint8_t screen[TXCOUNT];
+
+static bool Test_sameContent(TermWindow *a, TermWindow *b)
+{
+    for (int y = 0; y < a->yRes; y++)
+        if (memcmp(vga_data_array + (a->yPos + y) * FB_STRIDE + a->xPos / 2,
+                   vga_data_array + (b->yPos + y) * FB_STRIDE + b->xPos / 2, a->xRes / 2))
+            return false;
+    return true;
+}
+
+static bool Test_unchanged()
+{
+    return memcmp(screen, vga_data_array, TXCOUNT) == 0;
+}
+
+// A status panel: every row is a label and a value, each set up with its own cursor move and colours
+static void Test_panel(TermWindow *w, uint run)
+{
+    for (int row = 0; row < PANEL_ROWS; row++)
+    {
+        Window_setCursor(w, 0, row);
+        Window_setTextColour(w, 1 + row % 7);
+        Window_printf(w, "sensor %2d:", row);
+        Window_setTextColour(w, WHITE);
+        Window_setTextAttributes(w, (run + row) % 5 ? 0 : ATTR_INVERSE);
+        Window_printf(w, " %8u", run * 31 + row * 977);
+        Window_setTextAttributes(w, 0);
+    }
+}
+
+// Output which wraps, scrolls, clears and changes text size
+static void Test_session(TermWindow *w)
+{
+    for (int i = 0; i < 30; i++)
+        Window_printf(w, "line %d of a session which wraps around the window\n", i);
+    Window_scrollLines(w, 2);
+    Window_printf(w, "after the scroll");
+    Window_clear(w);
+    Window_printf(w, "after the clear\n");
+    Window_setTextSize(w, 2);
+    Window_printf(w, "large");
+    Window_putCell(w, 3, 2, '*', WINDOW_ATTR(RED, BLUE));
+}
+
+// A text size change draws what was written at the old size, so only output at one size is held back whole
+static void Test_batched(TermWindow *ref, TermWindow *w, void (*output)(TermWindow *w, uint run), uint run, bool heldBack)
+{
+    output(ref, run);
+
+    memcpy(screen, vga_data_array, TXCOUNT);
+    Window_beginUpdate(w);
+    Window_beginUpdate(w);
+    output(w, run);
+    CHECK(Test_unchanged() || !heldBack);
+    Window_endUpdate(w);
+    CHECK(Test_unchanged() || !heldBack);
+    Window_endUpdate(w);
+    CHECK(Test_sameContent(ref, w));
+}
+
+static void Test_sessionOutput(TermWindow *w, uint run)
+{
+    Test_session(w);
+}
+
+static uint32_t Test_timePanels(TermWindow *w, bool batched)
+{
+    uint32_t start = time_us_32();
+    for (int run = 0; run < PANEL_RUNS; run++)
+    {
+        if (batched)
+            Window_beginUpdate(w);
+        Test_panel(w, run);
+        if (batched)
+            Window_endUpdate(w);
+    }
+    return time_us_32() - start;
+}
+
+int main()
+{
+    Test_initIO();
+    TermWindow *ref = Window_createWindow(10, 20, 200, 120, "direct", WHITE);
+    TermWindow *w = Window_createWindow(230, 20, 200, 120, "batched", WHITE);
+    TermWindow *other = Window_createWindow(230, 200, 200, 120, "other", WHITE);
+
+    Test_batched(ref, w, Test_panel, 1, true);
+    Test_batched(ref, w, Test_panel, 2, true);
+    Test_batched(ref, w, Test_sessionOutput, 0, false);
+    Window_setTextSize(ref, 1);
+    Window_setTextSize(w, 1);
+    Test_batched(ref, w, Test_panel, 3, true);
+
+    // several windows: none of them is drawn before all updates end
+    Window_clear(ref);
+    Window_clear(w);
+    Window_clear(other);
+    TermWindow *group[] = {w, other};
+    memcpy(screen, vga_data_array, TXCOUNT);
+    Window_beginUpdates(group, 2);
+    Test_panel(w, 4);
+    Test_panel(other, 4);
+    CHECK(Test_unchanged());
+    Window_endUpdates(group, 2);
+    Test_panel(ref, 4);
+    CHECK(Test_sameContent(ref, w));
+    CHECK(Test_sameContent(ref, other));
+    CHECK(w->updateDepth == 0 && other->updateDepth == 0 && updateGroups == 0);
+
+    // unbalanced ends do nothing
+    Window_endUpdate(w);
+    CHECK(w->updateDepth == 0);
+
+    uint32_t directUs = Test_timePanels(ref, false);
+    uint32_t batchedUs = Test_timePanels(w, true);
+    CHECK(Test_sameContent(ref, w));
+    printf("benchmark,panel_repaint,runs,%u,direct_us,%u,batched_us,%u\n", PANEL_RUNS, (uint)directUs, (uint)batchedUs);
+
+    return Test_result("test_update");
+}
@@ -0,0 +1,98 @@
+// Converts a binary PPM (P6) image into a packed 3bpp WindowImage, written as C source.
+// Each colour channel is thresholded at half its maximum value.
+// Build on the host with: cc -o ppm2window ppm2window.c (it is also built with the host tests)
+// Usage: ppm2window [-rgb] [-8bpp] image.ppm name > name.c
+//     -rgb    pack colours for a display wired as RGB (VGA_BGR set to 0 in window.h)
+//     -8bpp   one pixel per byte, for a framebuffer configured with FB_BPP=8
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static int readNumber(FILE *f)
+{
+    int c = fgetc(f);
+    while (c != EOF && (isspace(c) || c == '#'))
+    {
+        if (c == '#')
+            while (c != EOF && c != '\n')
+                c = fgetc(f);
+        c = fgetc(f);
+    }
+
+    int n = -1;
+    while (c != EOF && isdigit(c))
+    {
+        n = (n < 0 ? 0 : n * 10) + c - '0';
+        c = fgetc(f);
+    }
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    int bgr = 1;
+    int pixelsPerByte = 2;
+    while (argc > 1 && argv[1][0] == '-')
+    {
+        if (strcmp(argv[1], "-rgb") == 0)
+            bgr = 0;
+        else if (strcmp(argv[1], "-8bpp") == 0)
+            pixelsPerByte = 1;
+        else
+            break;
+        argc--;
+        argv++;
+    }
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: ppm2window [-rgb] [-8bpp] image.ppm name\n");
+        return 1;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL || fgetc(f) != 'P' || fgetc(f) != '6')
+    {
+        fprintf(stderr, "%s: not a binary PPM file\n", argv[1]);
+        return 1;
+    }
+
+    int width = readNumber(f);
+    int height = readNumber(f);
+    int maxval = readNumber(f);
+    if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 255)
+    {
+        fprintf(stderr, "%s: unsupported PPM header\n", argv[1]);
+        return 1;
+    }
+
+    int rowBytes = (width + pixelsPerByte - 1) / pixelsPerByte;
+    unsigned char *packed = calloc(rowBytes, height);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+        {
+            int r = fgetc(f), g = fgetc(f), b = fgetc(f);
+            if (b == EOF)
+            {
+                fprintf(stderr, "%s: truncated image\n", argv[1]);
+                return 1;
+            }
+            r = r * 2 > maxval;
+            g = g * 2 > maxval;
+            b = b * 2 > maxval;
+            int col = bgr ? (r << 2) | (g << 1) | b : r | (g << 1) | (b << 2);
+            packed[y * rowBytes + x / pixelsPerByte] |= (x % pixelsPerByte) ? col << 3 : col;
+        }
+    fclose(f);
+
+    printf("#include \"window.h\"\n\n");
+    printf("static const uint8_t %s_data[%d] = {", argv[2], rowBytes * height);
+    for (int i = 0; i < rowBytes * height; i++)
+        printf("%s0x%02x,", (i % 16) ? " " : "\n    ", packed[i]);
+    printf("\n};\n\n");
+    printf("const WindowImage %s = {%d, %d, %s_data};\n", argv[2], width, height, argv[2]);
+
+    free(packed);
+    return 0;
+}
@@ -5,6 +5,7 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
 
 #include "window.h"
 #include "window_rtos.h"
@@ -14,18 +15,89 @@
 #include "ps2.h"
 
 TermWindow *activeWindow = NULL;
+TermWindow *modalWindow = NULL;
 TermWindow *windowCarousel[MAX_WINDOWS];
 uint nrWindows = 0;
 uint activeNr;
+volatile uint windowsGeneration = 0; // changes whenever a window is destroyed
 
-/// @brief Sets focus to the specified window
+// Windows created with Window_createWindow. A destroyed window's slot keeps its text buffer and key queue for the next window,
+// so that opening and closing windows does not churn the heap.
+static TermWindow windowPool[MAX_WINDOWS];
+static bool windowPoolUsed[MAX_WINDOWS];
+
+static uint32_t focusRequested, focusLatency, focusMaxLatency;
+
+static inline bool Window_isPooled(TermWindow *w)
+{
+    return w >= windowPool && w < windowPool + MAX_WINDOWS;
+}
+
+/// @brief Sets focus to the specified window. Keys go to it right away; its focus indicator is drawn by the render task.
 /// @param w pointer to the window to focus to
 void Window_setActiveWindow(TermWindow *w)
 {
-    if (activeWindow != NULL)
-        GFX_fillCircle(activeWindow->xPos + activeWindow->xRes - 10, activeWindow->yPos - 7, 3, WHITE);
     activeWindow = w;
-    GFX_fillCircle(activeWindow->xPos + activeWindow->xRes - 10, activeWindow->yPos - 7, 3, GREEN);
+    for (int i = 0; i < nrWindows; i++)
+        if (windowCarousel[i] == w)
+            activeNr = i;
+    WINDOW_TRACE(TRACE_FOCUS, w, 0);
+    focusRequested = time_us_32();
+    Window_raiseRenderer();
+}
+
+static void Window_drawFocusIndicator(TermWindow *w, bool focused)
+{
+    GFX_fillCircle(w->xPos + w->xRes - 10, w->yPos - 7, 3, focused ? GREEN : WHITE);
+    Window_markScreenDamage(w->xPos + w->xRes - 13, w->yPos - 10, 7, 7);
+    w->focusShown = focused;
+}
+
+/// @brief Brings the focus indicators up to date, redrawing only those which changed. Called by the render task, with the windows semaphore held.
+/// Windows in an update (under a dialog, for example) are left until it ends.
+void Window_drawFocus()
+{
+    for (int i = 0; i < nrWindows; i++)
+    {
+        TermWindow *w = windowCarousel[i];
+        bool focused = w == activeWindow;
+        if (w->focusShown == focused || w->updateDepth)
+            continue;
+
+        Window_drawFocusIndicator(w, focused);
+        if (focused)
+        {
+            focusLatency = time_us_32() - focusRequested;
+            if (focusLatency > focusMaxLatency)
+                focusMaxLatency = focusLatency;
+        }
+    }
+}
+
+/// @brief Returns how long focus changes took to show, from the focus switch to its indicator being drawn
+/// @param lastUs where to store the time of the last focus change, in microseconds
+/// @param maxUs where to store the longest time so far, in microseconds
+void Window_getFocusLatency(uint32_t *lastUs, uint32_t *maxUs)
+{
+    *lastUs = focusLatency;
+    *maxUs = focusMaxLatency;
+}
+
+/// @brief Draws the border and title bar of a window, with its focus indicator
+/// @param w Window
+void Window_drawFrame(TermWindow *w)
+{
+    uint xPos = w->xPos - 2, yPos = w->yPos - 2;
+    GFX_drawRect(xPos, yPos, w->xRes + 4, w->yRes + 4, w->borderCol);
+    GFX_fillRect(xPos, yPos - 10, w->xRes + 4, 10, WHITE);
+
+    GFX_setCursor(xPos + 1, yPos - 9);
+    GFX_setTextSize(1);
+    GFX_setTextColor(BLACK);
+    GFX_printf("%s", w->name);
+    if (w->focusShown)
+        GFX_fillCircle(w->xPos + w->xRes - 10, w->yPos - 7, 3, GREEN);
+    Window_markScreenDamage(xPos, yPos - 10, w->xRes + 4, w->yRes + 14);
 }
 
 /// @brief Initializes an already existing window
@@ -38,32 +110,71 @@ void Window_setActiveWindow(TermWindow *w)
 /// @param borderCol Border colour of the window
 void Window_initWindow(TermWindow *w, uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol)
 {
-    // Align everything to even collumns, to make shifting lines easier (because the framebuffer is 3bpp, 1 byte = 2 pixels)
-    if (xPos % 2)
+    // Align everything to whole framebuffer bytes, to make shifting lines easier (with 3bpp, 1 byte = 2 pixels)
+    while (xPos % FB_PIXELS_PER_BYTE)
         xPos++;
-    if (xSize % 2)
+    while (xSize % FB_PIXELS_PER_BYTE)
         xSize++;
 
     w->xPos = xPos + 2;
     w->yPos = yPos + 2;
     w->xRes = xSize;
     w->yRes = ySize;
+
+    // Text content is kept for the smallest text size, which has the most cells
+    w->maxRows = ySize / FONT_HEIGHT - 1;
+    w->maxCols = xSize / FONT_WIDTH;
+    uint cellsNum = w->maxRows * w->maxCols;
+    if (!Window_isPooled(w) || w->cells == NULL || w->cellsCapacity < cellsNum)
+    {
+        if (Window_isPooled(w))
+            vPortFree(w->cells);
+        w->cells = pvPortMalloc(cellsNum * sizeof(WindowCell));
+        w->cellsCapacity = cellsNum;
+    }
+    w->scrollCount = 0;
+    w->damage = (WindowRect){0, 0, 0, 0};
+    w->hidden.width = 0;
+    w->drawing = 0;
+    w->outputBusy = false;
+    w->updateDepth = 0;
+    w->dirtyRows = 0;
+    w->updateClear = false;
+    w->log = NULL;
+    w->records = NULL;
+    w->history = NULL;
+    w->highlights = NULL;
+    w->highlightPending = false;
+    w->nrHighlights = 0;
+    w->task = NULL;
+    w->stackWords = 0;
+    w->exitRequested = false;
+    w->exiting = false;
     Window_setTextSize(w, 1);
 
     w->borderCol = borderCol;
-    GFX_drawRect(xPos, yPos, xSize + 4, ySize + 4, borderCol);
-    GFX_fillRect(w->xPos - 2, yPos - 10, xSize + 4, 10, WHITE);
-
-    GFX_setCursor(xPos + 1, yPos - 9);
-    GFX_setTextColor(BLACK);
-    GFX_printf(name);
+    w->focusShown = false;
+    strncpy(w->name, name, WINDOW_NAME_LEN - 1);
+    w->name[WINDOW_NAME_LEN - 1] = 0;
 
     Window_setTextColour(w, WHITE);
+    Window_setBackgroundColour(w, BLACK);
+    Window_setTextAttributes(w, 0);
     Window_setCursor(w, 0, 0);
+    Window_clearCells(w, 0, w->maxRows);
 
+    if (!Window_isPooled(w) || w->keyQueue == NULL)
+        w->keyQueue = xQueueCreate(KEYBUF_LEN, sizeof(char));
+
+    // Frames are drawn with the shared GFX state, and the list of windows may be changed from the other core
+    takeWindowsSemaphore();
+    Window_drawFrame(w);
+    takeKeySemaphore();
     activeNr = nrWindows;
     windowCarousel[nrWindows++] = w;
     Window_setActiveWindow(w);
+    giveKeySemaphore();
+    giveWindowsSemaphore();
 }
 
 /// @brief Creates and initalizes a window
@@ -73,22 +184,123 @@ void Window_initWindow(TermWindow *w, uint xPos, uint yPos, uint xSize, uint ySi
 /// @param ySize Vertical size of the window
 /// @param name Name of the task and window
 /// @param borderCol Border colour of the window
-/// @return Pointer to the created window
+/// @return Pointer to the created window, or NULL if MAX_WINDOWS windows already exist
 TermWindow *Window_createWindow(uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol)
 {
-    TermWindow *w = pvPortMalloc(sizeof(TermWindow));
-    Window_initWindow(w, xPos, yPos, xSize, ySize, name, borderCol);
+    TermWindow *w = NULL;
+    enterCritical();
+    for (int i = 0; i < MAX_WINDOWS && w == NULL; i++)
+        if (!windowPoolUsed[i])
+        {
+            windowPoolUsed[i] = true;
+            w = &windowPool[i];
+        }
+    exitCritical();
+
+    if (w != NULL)
+        Window_initWindow(w, xPos, yPos, xSize, ySize, name, borderCol);
     return w;
 }
 
-/// @brief Shifts focus to the next window
+/// @brief Removes a window from the screen's list of windows and frees it. Its task is deleted if it is parked in Window_exitTask,
+/// where it holds no locks; windows of tasks which still run must not be released.
+/// @param erase false to leave the window's pixels on screen, for callers which draw over them
+void Window_release(TermWindow *w, bool erase)
+{
+    takeWindowsSemaphore();
+
+    int id = 0;
+    while (id < nrWindows && windowCarousel[id] != w)
+        id++;
+    if (id == nrWindows)
+    {
+        giveWindowsSemaphore();
+        return;
+    }
+
+    if (w->task != NULL && w->exiting)
+        vTaskDelete(w->task);
+
+    takeKeySemaphore();
+    Window_unbindFocusKeys(w);
+    for (int i = id; i < nrWindows - 1; i++)
+        windowCarousel[i] = windowCarousel[i + 1];
+    nrWindows--;
+    windowCarousel[nrWindows] = NULL;
+    if (id < activeNr)
+        activeNr--;
+    if (activeWindow == w)
+    {
+        activeWindow = NULL;
+        if (activeNr >= nrWindows)
+            activeNr = 0;
+        if (nrWindows)
+            Window_setActiveWindow(windowCarousel[activeNr]);
+    }
+    giveKeySemaphore();
+
+    // Border and title bar included
+    if (erase)
+    {
+        GFX_fillRect(w->xPos - 2, w->yPos - 12, w->xRes + 4, w->yRes + 14, BLACK);
+        Window_markScreenDamage(w->xPos - 2, w->yPos - 12, w->xRes + 4, w->yRes + 14);
+    }
+    w->damage.width = 0;
+
+    Window_freeLogs(w);
+    vPortFree(w->highlights);
+    w->highlights = NULL;
+    if (w->history != NULL)
+    {
+        vPortFree(w->history->lines);
+        vPortFree(w->history);
+        w->history = NULL;
+    }
+    xQueueReset(w->keyQueue);
+    if (Window_isPooled(w))
+        windowPoolUsed[w - windowPool] = false;
+    else
+    {
+        vPortFree(w->cells);
+        vQueueDelete(w->keyQueue);
+    }
+    windowsGeneration++;
+
+    giveWindowsSemaphore();
+}
+
+/// @brief Destroys a window: ends the task created with it, erases it from the screen, frees its memory and passes focus on.
+/// If called from the window's own task, this is Window_exitTask and does not return.
+/// A task is never deleted where it stands, as it could hold a lock. When another task destroys the window, the window's task
+/// is asked to exit instead, which it does at its next Window_getchar, Window_tryGetchar or Window_readLine (or when it sees
+/// Window_exitRequested), and the window is destroyed then.
+/// Windows without a task are destroyed right away; other tasks should not be in the middle of writing to them.
+/// @param w Window to destroy
+void Window_destroy(TermWindow *w)
+{
+    if (w->task != NULL)
+    {
+        if (w->task == xTaskGetCurrentTaskHandle())
+            Window_exitTask(w);
+
+        // wakes the task if it waits for a key; the render task releases the window once the task is parked
+        w->exitRequested = true;
+        char wake = 0;
+        xQueueSendToBack(w->keyQueue, &wake, 0);
+        return;
+    }
+    Window_release(w, true);
+}
+
+/// @brief Shifts focus to the next window. While a dialog is open, focus stays on it.
 void Window_nextWindow()
 {
+    if (modalWindow != NULL || nrWindows == 0)
+        return;
     if (activeNr < nrWindows - 1)
         activeNr++;
     else
         activeNr = 0;
-    kbKeys = 0; // clear keypress buffer when switching focus
     Window_setActiveWindow(windowCarousel[activeNr]);
 }
 
@@ -127,6 +339,9 @@ void Window_splash()
     GFX_setTextColor(WHITE);
     GFX_printf("Based on FreeRTOS %s\n", tskKERNEL_VERSION_NUMBER);
 
+    Window_markScreenDamage(0, 0, FB_WIDTH, FB_HEIGHT);
+    Window_flushDisplay();
+
     while (!PS2_keyAvailable())
         ;
     char c = PS2_readKey();
@@ -143,5 +358,21 @@ void Window_initIO(uint d, uint c, uint vsync_pin, uint hsync_pin, uint r_pin)
     PS2_init(d, c);
     VGA_initDisplay(vsync_pin, hsync_pin, r_pin);
     Window_splash();
+    Window_loadFont();
+    VGA_fillScreen(BLACK);
+}
+
+/// @brief Initializes the PS2 keyboard and a display other than the VGA output, such as an SPI panel
+/// @param d PS2 data pin
+/// @param c PS2 clock pin
+/// @param display Display backend, already initialized
+void Window_initIOWithDisplay(uint d, uint c, const WindowDisplay *display)
+{
+    PS2_init(d, c);
+    Window_setDisplay(display);
+    Window_splash();
+    Window_loadFont();
     VGA_fillScreen(BLACK);
+    Window_markScreenDamage(0, 0, FB_WIDTH, FB_HEIGHT);
+    Window_flushDisplay();
 }
@@ -3,9 +3,37 @@
 
 #include "pico/stdlib.h"
 #include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+#include "window_config.h"
 
 #define VGA_BGR 1
 #define MAX_WINDOWS 10
+#ifndef WINDOW_TASK_STACK
+#define WINDOW_TASK_STACK 2048 // stack of tasks created with their window, in words
+#endif
+#define KEYBUF_LEN 50
+#define MAX_EVENT_SOURCES 16
+#define MAX_INPUT_SOURCES 4
+#define INPUT_BATCH_LEN 32
+
+#define WINDOW_WAIT_FOREVER 0xFFFFFFFF
+#define DISPLAY_MAX_REGIONS 8
+#define DISPLAY_FRAME_MS 20
+#define MAX_TEXT_SIZE 8
+#define LOG_LINE_LEN 100
+#define RECORD_MAX_ARGS 6
+#define RECORD_BUSY 0xFFFFFFFF
+#define FIELD_MAX_LEN 32
+#define READ_STRING_LEN 50 // buffer size Window_readString assumes
+#define HISTORY_LINE_LEN 80
+#define MAX_HIGHLIGHTS 32
+#define WINDOW_NAME_LEN 24
+#define MAX_LAYOUT_NODES 16
+#define MAX_FOCUS_KEYS 8
+#define WINDOW_BENCHMARKS 6
+#define WINDOW_BENCH_RESULTS (WINDOW_BENCHMARKS + MAX_TEXT_SIZE - 1) // the glyph benchmark runs at every text size
 
 #define WINDOW_VER "1.00"
 
@@ -29,6 +57,11 @@
 #define WHITE 7
 #endif
 
+// Text cell attributes: foreground colour in bits 0-2, background colour in bits 3-5
+#define ATTR_INVERSE 0x40
+#define ATTR_UNDERLINE 0x80
+#define WINDOW_ATTR(fg, bg) ((fg) | ((bg) << 3))
+
 #define PS2_TAB 9
 #define PS2_ENTER 13
 #define PS2_BACKSPACE 127
@@ -41,8 +74,132 @@
 #define PS2_DOWNARROW 10
 #define PS2_RIGHTARROW 21
 
+typedef struct WindowCell
+{
+    char c;
+    uint8_t attr;
+
+} WindowCell;
+
+typedef struct WindowRect
+{
+    int x, y;
+    int width, height;
+
+} WindowRect;
+
+// Image laid out like the framebuffer (see FB_BPP): with 3bpp, (width + 1) / 2 bytes per row,
+// even pixels in bits 0-2 and odd pixels in bits 3-5 of each byte
+typedef struct WindowImage
+{
+    uint16_t width, height;
+    const uint8_t *data;
+
+} WindowImage;
+
+// Display backend. The window layer always draws into the framebuffer in RAM;
+// flush pushes a changed region of it to the display and returns the number of bytes transferred.
+// Backends which show the framebuffer directly (VGA) have no flush function.
+typedef struct WindowDisplay
+{
+    uint (*flush)(uint x, uint y, uint width, uint height);
+
+} WindowDisplay;
+
+extern const WindowDisplay Window_vgaDisplay;
+extern const WindowDisplay Window_memoryDisplay;
+
+// Source of keypresses, polled by the input task. read fills buf with up to len keys which are available right away
+// and returns their number. Keys which do not fit into the window in focus stay pending, and the source is not read
+// again until they have been delivered.
+typedef struct WindowInputSource
+{
+    const char *name;
+    uint (*read)(struct WindowInputSource *s, char *buf, uint len);
+
+    void *data; // backend state
+    uint pos, len;
+
+    char pending[INPUT_BATCH_LEN];
+    uint pendingPos, pendingLen;
+
+    uint32_t received, delivered, dropped, stalls;
+
+} WindowInputSource;
+
+extern WindowInputSource Window_ps2Input;
+extern WindowInputSource Window_stdioInput;
+
+typedef struct WindowLog
+{
+    uint8_t *buf;
+    uint size;
+    volatile uint32_t head; // end of the space reserved by producers
+    volatile uint32_t tail; // end of the lines drawn so far
+    uint32_t dropped;
+
+} WindowLog;
+
+typedef struct WindowRecord
+{
+    volatile uint32_t seq;
+    const char *format;
+    uintptr_t args[RECORD_MAX_ARGS]; // the arguments as pointer-sized words, converted back by the format when drawn
+
+} WindowRecord;
+
+typedef struct WindowRecordLog
+{
+    WindowRecord *recs;
+    uint count;
+    volatile uint32_t head; // sequence number of the next record
+    uint32_t drawn;         // records before this one have been drawn or skipped
+    uint32_t viewOffset;    // how many records the view is scrolled back
+    volatile bool redraw;
+
+} WindowRecordLog;
+
+// Field of a dashboard: a value of fixed width at a fixed place, after its label
+typedef struct WindowField
+{
+    uint8_t col, row;
+    uint8_t width;
+    uint8_t attr;
+    char shown[FIELD_MAX_LEN]; // what is on screen now
+
+} WindowField;
+
+typedef struct WindowDashboard
+{
+    struct TermWindow *w;
+    WindowField *fields;
+    uint nrFields, maxFields;
+    TickType_t lastWake;
+    uint32_t updates, redrawn;
+
+} WindowDashboard;
+
+// Text found in a window, within a single row
+typedef struct WindowMatch
+{
+    uint8_t row, col;
+    uint8_t len;
+
+} WindowMatch;
+
+// Lines entered with Window_readLine, each kept in a slot of HISTORY_LINE_LEN bytes
+typedef struct WindowHistory
+{
+    char *lines;
+    uint entries;
+    uint count; // lines stored so far
+    uint next;  // slot of the next line
+
+} WindowHistory;
+
 typedef struct TermWindow
 {
+    char name[WINDOW_NAME_LEN];
     uint xPos, yPos;
     uint xRes, yRes;
     uint term_rows, term_cols;
@@ -52,41 +209,293 @@ typedef struct TermWindow
     uint bgCol;
     uint textCol;
     uint borderCol;
+    uint8_t textAttr;
+    bool focusShown; // the focus indicator in the title bar is lit
 
-    char termScanBuf[50];
+    char termScanBuf[READ_STRING_LEN];
     char termPrintBuf[50];
 
+    QueueHandle_t keyQueue;
+
+    WindowCell *cells;
+    uint cellsCapacity;
+    uint maxRows, maxCols;
+    uint scrollCount;
+
+    WindowRect damage; // area changed since it was last taken, relative to the window
+
+    WindowRect hidden;      // part of the content under a dialog, which canvas and image drawing leaves out (width 0 if none)
+    volatile uint drawing;  // nesting of drawing calls in progress, which opening a dialog waits for
+    volatile bool outputBusy; // a task is drawing the window's text or changing its pending update
+
+    uint updateDepth;   // nesting of Window_beginUpdate
+    uint64_t dirtyRows; // text rows to redraw when the update ends
+    uint8_t dirtyFrom[64], dirtyTo[64]; // columns of each dirty row to redraw, the last one included
+    bool updateClear;   // the window was cleared during the update
+
+    WindowLog *log;
+    WindowRecordLog *records;
+    WindowHistory *history;
+
+    WindowMatch *highlights;
+    uint nrHighlights;
+    uint highlightScroll; // scrollCount when the highlights were drawn
+    bool highlightPending; // the highlights are drawn when the window's update ends
+
+    TaskHandle_t task; // task created with the window, if any
+    uint stackWords;   // size of the task's stack, 0 if not known
+    volatile bool exitRequested; // Window_destroy was called by another task, for the window's task to end itself
+    volatile bool exiting;       // the task is parked in Window_exitTask, where it is safe to delete
+
 } TermWindow;
 
+// Byte stream from one producer task to one consumer task. Both ends can work in place in the pipe's buffer.
+typedef struct WindowPipe
+{
+    uint8_t *buf;
+    uint size;
+    volatile uint32_t head; // end of the committed data
+    volatile uint32_t tail; // end of the released data
+    volatile TaskHandle_t reader, writer; // tasks waiting for data or for room
+    TermWindow *tee;
+    uint32_t bytes;
+
+} WindowPipe;
+
+typedef enum WindowLayoutType
+{
+    LAYOUT_SLOT,    // place for one window
+    LAYOUT_ROWS,    // children stacked top to bottom
+    LAYOUT_COLUMNS, // children side by side
+    LAYOUT_GRID,    // children in equal cells, row by row
+
+} WindowLayoutType;
+
+typedef struct WindowLayoutNode
+{
+    uint8_t type;
+    uint8_t parent;
+    uint8_t weight;   // share of the parent's space, in rows and columns
+    uint8_t gridCols; // for grids
+    WindowRect rect;  // screen area, computed by the layout
+    TermWindow *w;    // for slots
+
+} WindowLayoutNode;
+
+// Tree of splits dividing an area of the screen between windows. Node 0 is the root, which stacks its children as rows.
+typedef struct WindowLayout
+{
+    WindowRect area;
+    WindowLayoutNode nodes[MAX_LAYOUT_NODES];
+    uint nrNodes;
+
+} WindowLayout;
+
+#define LAYOUT_ROOT 0
+
+// Hot paths timed by Window_runBenchmark
+typedef enum WindowBenchmark
+{
+    WINDOW_BENCH_GLYPH,   // a row of glyphs, at the window's text size
+    WINDOW_BENCH_SCROLL,  // Window_scrollLines by one line
+    WINDOW_BENCH_CLEAR,   // Window_clear
+    WINDOW_BENCH_PRINTF,  // Window_printf of a formatted line
+    WINDOW_BENCH_GETCHAR, // Window_getchar on a waiting key
+    WINDOW_BENCH_FOCUS,   // focus switch until its indicator is drawn
+
+} WindowBenchmark;
+
+// Times of one benchmark, in microseconds per sample
+typedef struct WindowBenchResult
+{
+    const char *name;
+    uint32_t samples;
+    uint32_t minUs, medianUs, meanUs, p95Us, maxUs;
+    uint32_t opsPerSample; // glyphs, lines or keys handled by a sample
+
+} WindowBenchResult;
+
+typedef struct WindowEventSet
+{
+    QueueSetHandle_t set;
+    uint nrSources;
+    QueueSetMemberHandle_t sources[MAX_EVENT_SOURCES];
+
+} WindowEventSet;
+
 extern TermWindow *activeWindow;
 
+struct spi_inst; // spi_inst_t, from hardware/spi.h
+
 void Window_initIO(uint d, uint c, uint vsync_pin, uint hsync_pin, uint r_pin);
+void Window_initIOWithDisplay(uint d, uint c, const WindowDisplay *display);
+
+void Window_setDisplay(const WindowDisplay *d);
+void Window_flushDisplay();
+void Window_markScreenDamage(int x, int y, int width, int height);
+void Window_getDisplayStats(uint32_t *frames, uint32_t *bytes);
+const WindowDisplay *Window_initSpiDisplay(struct spi_inst *spi, uint dc, uint cs, uint rst);
 
 void Window_createTaskWithWindow(TaskFunction_t taskFunc, uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol);
+void Window_createTaskWithWindowStack(TaskFunction_t taskFunc, uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol, uint stackWords);
 void Window_startRTOS();
 
+void Window_getHeapStats(uint32_t *used, uint32_t *reserved);
+void Window_printProfile(TermWindow *w);
+bool Window_runBenchmark(TermWindow *w, WindowBenchmark b, uint samples, WindowBenchResult *r);
+uint Window_runBenchmarks(TermWindow *w, uint samples, WindowBenchResult *results, uint maxResults);
+void Window_printBenchmarks(const char *variant, const WindowBenchResult *results, uint n);
+
 void Window_initWindow(TermWindow *w, uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol);
 TermWindow *Window_createWindow(uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol);
+void Window_destroy(TermWindow *w);
+void Window_exitTask(TermWindow *w);
+bool Window_exitRequested(TermWindow *w);
+TermWindow *Window_openDialog(uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol);
+void Window_closeDialog(TermWindow *d);
+void Window_getDialogLatency(uint32_t *openUs, uint32_t *closeUs);
 void Window_setActiveWindow(TermWindow *w);
 void Window_nextWindow();
+bool Window_bindFocusKey(char key, TermWindow *w);
+void Window_getFocusLatency(uint32_t *lastUs, uint32_t *maxUs);
+bool Window_setCoreAffinity(TermWindow *w, uint coreMask);
 
 uint Window_getRows(TermWindow *w);
 uint Window_getCols(TermWindow *w);
 void Window_setTextSize(TermWindow *w, uint s);
 void Window_setCursor(TermWindow *w, int col, int row);
 void Window_setTextColour(TermWindow *w, uint8_t col);
+void Window_setBackgroundColour(TermWindow *w, uint8_t col);
+void Window_setTextAttributes(TermWindow *w, uint8_t attr);
 
 void Window_clear(TermWindow *w);
 void Window_scrollLines(TermWindow *w, int linesNum);
 
+void Window_beginUpdate(TermWindow *w);
+void Window_endUpdate(TermWindow *w);
+void Window_beginUpdates(TermWindow *ws[], uint n);
+void Window_endUpdates(TermWindow *ws[], uint n);
+
 void Window_write(TermWindow *w, unsigned char c);
 void Window_printString(TermWindow *w, char s[]);
 void Window_printf(TermWindow *w, const char *format, ...);
 
+void Window_enableLog(TermWindow *w, uint size);
+void Window_logLine(TermWindow *w, const char *format, ...);
+uint32_t Window_getLogDropped(TermWindow *w);
+
+#define RECORD_NARGS(...) RECORD_NARGS_(_, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define RECORD_NARGS_(_, a1, a2, a3, a4, a5, a6, n, ...) n
+// Each argument is passed as a uintptr_t, which holds integers, characters and pointers alike
+#define RECORD_ARG(a) ((uintptr_t)(a))
+#define RECORD_ARGS_0()
+#define RECORD_ARGS_1(a) , RECORD_ARG(a)
+#define RECORD_ARGS_2(a, ...) , RECORD_ARG(a) RECORD_ARGS_1(__VA_ARGS__)
+#define RECORD_ARGS_3(a, ...) , RECORD_ARG(a) RECORD_ARGS_2(__VA_ARGS__)
+#define RECORD_ARGS_4(a, ...) , RECORD_ARG(a) RECORD_ARGS_3(__VA_ARGS__)
+#define RECORD_ARGS_5(a, ...) , RECORD_ARG(a) RECORD_ARGS_4(__VA_ARGS__)
+#define RECORD_ARGS_6(a, ...) , RECORD_ARG(a) RECORD_ARGS_5(__VA_ARGS__)
+#define RECORD_ARGS(n, ...) RECORD_ARGS_N(n, __VA_ARGS__)
+#define RECORD_ARGS_N(n, ...) RECORD_ARGS_##n(__VA_ARGS__)
+#define WINDOW_LOG_RECORD(w, format, ...) \
+    Window_logRecord(w, format, RECORD_NARGS(__VA_ARGS__) RECORD_ARGS(RECORD_NARGS(__VA_ARGS__), __VA_ARGS__))
+
+void Window_enableRecordLog(TermWindow *w, uint records);
+void Window_logRecord(TermWindow *w, const char *format, uint nargs, ...);
+void Window_scrollRecordLog(TermWindow *w, int records);
+
+WindowDashboard *Window_createDashboard(TermWindow *w, uint maxFields);
+int Window_addField(WindowDashboard *d, uint col, uint row, const char *label, uint width);
+uint Window_setField(WindowDashboard *d, int field, const char *format, ...);
+void Window_waitDashboardPeriod(WindowDashboard *d, uint ms);
+void Window_getDashboardStats(WindowDashboard *d, uint32_t *updates, uint32_t *redrawn);
+
 char Window_getchar(TermWindow *w);
+bool Window_tryGetchar(TermWindow *w, char *c);
+uint Window_keysAvailable(TermWindow *w);
 void Window_readString(TermWindow *w, char termScanBuf[]);
+uint Window_readLine(TermWindow *w, char *buf, uint len);
+bool Window_enableHistory(TermWindow *w, uint entries);
 void Window_scanf(TermWindow *w, const char *format, ...);
 
+bool Window_addInputSource(WindowInputSource *s);
+void Window_initReplayInput(WindowInputSource *s, const char *name, const char *script, uint len);
+void Window_initHarnessInput(WindowInputSource *s, const char *name, uint length);
+uint Window_injectKeys(WindowInputSource *s, const char *keys, uint len, uint ms);
+void Window_getInputStats(WindowInputSource *s, uint32_t *received, uint32_t *delivered, uint32_t *dropped, uint32_t *stalls);
+
+WindowPipe *Window_createPipe(uint size);
+void Window_teePipe(WindowPipe *p, TermWindow *w);
+uint8_t *Window_pipeReserve(WindowPipe *p, uint *len, uint ms);
+void Window_pipeCommit(WindowPipe *p, uint len);
+const uint8_t *Window_pipePeek(WindowPipe *p, uint *len, uint ms);
+void Window_pipeRelease(WindowPipe *p, uint len);
+uint Window_pipeWrite(WindowPipe *p, const void *data, uint len, uint ms);
+uint Window_pipeRead(WindowPipe *p, void *buf, uint len, uint ms);
+uint32_t Window_getPipeBytes(WindowPipe *p);
+
+WindowEventSet *Window_createEventSet(uint length);
+int Window_addWindowToEventSet(WindowEventSet *s, TermWindow *w);
+int Window_addQueueToEventSet(WindowEventSet *s, QueueHandle_t q);
+int Window_waitEvent(WindowEventSet *s, uint ms);
+
+void Window_initLayout(WindowLayout *l, uint x, uint y, uint width, uint height);
+int Window_addLayoutSplit(WindowLayout *l, int parent, WindowLayoutType type, uint weight);
+int Window_addLayoutGrid(WindowLayout *l, int parent, uint cols, uint weight);
+int Window_addLayoutSlot(WindowLayout *l, int parent, uint weight);
+TermWindow *Window_createLayoutWindow(WindowLayout *l, int slot, char name[], uint8_t borderCol);
+void Window_createTaskWithLayout(TaskFunction_t taskFunc, WindowLayout *l, int slot, char name[], uint8_t borderCol);
+void Window_setLayoutWeight(WindowLayout *l, int node, uint weight);
+void Window_setLayoutWindow(WindowLayout *l, int slot, TermWindow *w);
+bool Window_applyLayout(WindowLayout *l);
+
+uint Window_search(TermWindow *w, const char *pattern, WindowMatch *matches, uint maxMatches);
+uint Window_highlight(TermWindow *w, const char *pattern);
+void Window_clearHighlight(TermWindow *w);
+uint32_t Window_getSearchTime();
+void Window_enableSearchKey(char key);
+
+void Window_canvasPixel(TermWindow *w, int x, int y, uint8_t col);
+void Window_canvasHLine(TermWindow *w, int x, int y, int len, uint8_t col);
+void Window_canvasVLine(TermWindow *w, int x, int y, int len, uint8_t col);
+void Window_canvasFillRect(TermWindow *w, int x, int y, int width, int height, uint8_t col);
+void Window_canvasRect(TermWindow *w, int x, int y, int width, int height, uint8_t col);
+void Window_canvasLine(TermWindow *w, int x0, int y0, int x1, int y1, uint8_t col);
+void Window_canvasCircle(TermWindow *w, int x0, int y0, int r, uint8_t col);
+void Window_canvasFillCircle(TermWindow *w, int x0, int y0, int r, uint8_t col);
+void Window_canvasText(TermWindow *w, int x, int y, const char *s, uint size, uint8_t col);
+
+void Window_blit(TermWindow *w, const WindowImage *img, int x, int y);
+void Window_blitTransparent(TermWindow *w, const WindowImage *img, int x, int y, uint8_t transparent);
+
+void Window_markDamage(TermWindow *w, int x, int y, int width, int height);
+bool Window_takeDamage(TermWindow *w, WindowRect *r);
+
+// Outcome of replaying a session trace
+typedef struct WindowReplayResult
+{
+    uint32_t events;     // events in the trace
+    uint32_t replayed;   // API calls replayed
+    uint64_t recordedUs; // duration of the recorded session
+    uint64_t elapsedUs;  // duration of the replay
+    uint64_t busyUs;     // time spent inside the replayed API calls
+    uint32_t checksum;   // checksum of the screen after the replay
+
+} WindowReplayResult;
+
+void Window_startTrace(uint8_t *buf, uint len);
+uint Window_stopTrace();
+bool Window_replayTrace(const uint8_t *buf, uint len, bool timed, WindowReplayResult *res);
+
+uint Window_snapshotRect(uint x, uint y, uint width, uint height, uint8_t *buf, uint bufLen);
+uint Window_snapshotScreen(uint8_t *buf, uint bufLen);
+uint Window_snapshotWindow(TermWindow *w, uint8_t *buf, uint bufLen);
+bool Window_restoreSnapshot(const uint8_t *buf, uint len);
+uint32_t Window_screenChecksum();
+
+void Window_startMirror(uint bytesPerSecond);
+uint32_t Window_getMirrorBytesSent();
+
 void Window_taskYield();
 void Window_delay(uint ms);
 
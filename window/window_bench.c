@@ -0,0 +1,226 @@
+#include "pico/stdlib.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "window.h"
+#include "window_rtos.h"
+
+// A focus switch which has not shown after this long is given up on (the other window may be under a dialog)
+#define BENCH_FOCUS_TIMEOUT_US 100000
+
+typedef void (*BenchFunc)(TermWindow *w, uint i);
+
+static void Bench_glyphs(TermWindow *w, uint i)
+{
+    // a whole row, as single glyphs are below the timer's resolution
+    for (int col = 0; col < w->term_cols; col++)
+        Window_drawGlyph(w, col, 0, 'A' + (col + i) % 26, WINDOW_ATTR(w->textCol, w->bgCol));
+}
+
+static void Bench_scroll(TermWindow *w, uint i)
+{
+    Window_scrollLines(w, 1);
+}
+
+static void Bench_clear(TermWindow *w, uint i)
+{
+    Window_clear(w);
+}
+
+static void Bench_printf(TermWindow *w, uint i)
+{
+    Window_printf(w, "%5u %08x %s\n", i, i * 2654435761u, "bench");
+}
+
+static int Bench_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/// @brief Sums up the times of a benchmark's samples. Sorts the samples.
+static void Bench_summarize(WindowBenchResult *r, const char *name, uint32_t *times, uint n)
+{
+    r->opsPerSample = 1;
+    qsort(times, n, sizeof(uint32_t), Bench_compare);
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += times[i];
+
+    r->name = name;
+    r->samples = n;
+    r->minUs = n ? times[0] : 0;
+    r->medianUs = n ? times[n / 2] : 0;
+    r->meanUs = n ? sum / n : 0;
+    r->p95Us = n ? times[(n * 95) / 100] : 0;
+    r->maxUs = n ? times[n - 1] : 0;
+}
+
+static void Bench_run(TermWindow *w, const char *name, BenchFunc f, uint32_t *times, uint n, WindowBenchResult *r)
+{
+    for (int i = 0; i < n; i++)
+    {
+        uint32_t start = time_us_32();
+        f(w, i);
+        times[i] = time_us_32() - start;
+    }
+    Bench_summarize(r, name, times, n);
+}
+
+/// @brief Times taking a key from a window's buffer. The key is put there beforehand, so Window_getchar does not wait.
+static void Bench_getchar(TermWindow *w, uint32_t *times, uint n, WindowBenchResult *r)
+{
+    xQueueReset(w->keyQueue);
+    for (int i = 0; i < n; i++)
+    {
+        char c = 'a' + i % 26;
+        xQueueSendToBack(w->keyQueue, &c, 0);
+        uint32_t start = time_us_32();
+        Window_getchar(w);
+        times[i] = time_us_32() - start;
+    }
+    Bench_summarize(r, "getchar", times, n);
+}
+
+static bool Bench_switchFocus(TermWindow *to, uint32_t *time)
+{
+    uint32_t start = time_us_32();
+    takeKeySemaphore();
+    Window_setActiveWindow(to);
+    giveKeySemaphore();
+    while (!to->focusShown)
+    {
+        if (time_us_32() - start > BENCH_FOCUS_TIMEOUT_US)
+            return false;
+        Window_taskYield();
+    }
+    *time = time_us_32() - start;
+    return true;
+}
+
+/// @brief Times focus switches, from the switch until the render task has drawn the indicator, between a window and another one
+/// @return false if there is no other window to switch to
+static bool Bench_focus(TermWindow *w, uint32_t *times, uint n, WindowBenchResult *r)
+{
+    TermWindow *other = NULL;
+    takeWindowsSemaphore();
+    for (int i = 0; i < nrWindows && other == NULL; i++)
+        if (windowCarousel[i] != w)
+            other = windowCarousel[i];
+    giveWindowsSemaphore();
+    if (other == NULL || modalWindow != NULL)
+        return false;
+
+    uint done = 0;
+    for (int i = 0; i < n; i++)
+        if (Bench_switchFocus((i % 2) ? w : other, &times[done]))
+            done++;
+    uint32_t last;
+    Bench_switchFocus(w, &last);
+    Bench_summarize(r, "focus", times, done);
+    return true;
+}
+
+/// @brief Runs a microbenchmark of one hot path of the window system. Times are taken with the microsecond timer.
+/// Drawing benchmarks draw over the window, glyphs at its text size. Focus switching is timed against another window.
+/// @param w Window to run the benchmark in, which must be in focus
+/// @param b Benchmark to run
+/// @param samples How many times the benchmark runs
+/// @param r where to store the result
+/// @return false if there is not enough memory for the samples, or no other window to switch focus to
+bool Window_runBenchmark(TermWindow *w, WindowBenchmark b, uint samples, WindowBenchResult *r)
+{
+    static const char *names[] = {"glyph_row", "scroll", "clear", "printf"};
+    static char glyphNames[MAX_TEXT_SIZE][16];
+    static const BenchFunc funcs[] = {Bench_glyphs, Bench_scroll, Bench_clear, Bench_printf};
+
+    uint32_t *times = pvPortMalloc((samples ? samples : 1) * sizeof(uint32_t));
+    if (times == NULL)
+        return false;
+
+    bool done = true;
+    if (b == WINDOW_BENCH_GETCHAR)
+        Bench_getchar(w, times, samples, r);
+    else if (b == WINDOW_BENCH_FOCUS)
+        done = Bench_focus(w, times, samples, r);
+    else if (b == WINDOW_BENCH_GLYPH)
+    {
+        char *name = glyphNames[w->textSize - 1];
+        snprintf(name, sizeof(glyphNames[0]), "glyph_row_x%u", w->textSize);
+        Bench_run(w, name, funcs[b], times, samples, r);
+        r->opsPerSample = w->term_cols;
+    }
+    else
+        Bench_run(w, names[b], funcs[b], times, samples, r);
+
+    vPortFree(times);
+    return done;
+}
+
+/// @brief Times a row of glyphs at every text size, which for sizes above 1 come from the cache of scaled glyphs.
+/// Sizes whose glyphs do not fit into memory are left out. The window's text size is restored.
+/// @return Number of results stored, or -1 if there is not enough memory for the samples
+static int Bench_glyphSizes(TermWindow *w, uint samples, WindowBenchResult *results, uint maxResults)
+{
+    uint size = w->textSize, n = 0;
+    for (uint s = 1; s <= MAX_TEXT_SIZE && n < maxResults; s++)
+    {
+        Window_setTextSize(w, s);
+        if (w->textSize != s)
+            continue;
+        if (!Window_runBenchmark(w, WINDOW_BENCH_GLYPH, samples, &results[n]))
+        {
+            Window_setTextSize(w, size);
+            return -1;
+        }
+        n++;
+    }
+    Window_setTextSize(w, size);
+    return n;
+}
+
+/// @brief Runs a microbenchmark of each hot path of the window system: drawing a row of glyphs at each text size,
+/// scrolling, clearing, formatted printing, reading a key and switching focus (see Window_runBenchmark). The window is
+/// drawn over, and cleared before the input benchmarks. Focus switching is left out if there is no other window.
+/// @param w Window to run the benchmarks in, which must be in focus
+/// @param samples How many times each benchmark runs
+/// @param results Array to store the results into
+/// @param maxResults Size of the array (WINDOW_BENCH_RESULTS holds all of them)
+/// @return Number of results stored, or 0 if there is not enough memory for the samples
+uint Window_runBenchmarks(TermWindow *w, uint samples, WindowBenchResult *results, uint maxResults)
+{
+    int n = Bench_glyphSizes(w, samples, results, maxResults);
+    if (n < 0)
+        return 0;
+    for (int b = WINDOW_BENCH_GLYPH + 1; b < WINDOW_BENCHMARKS && n < maxResults; b++)
+    {
+        if (b == WINDOW_BENCH_GETCHAR)
+            Window_clear(w);
+        if (Window_runBenchmark(w, b, samples, &results[n]))
+            n++;
+        else if (b != WINDOW_BENCH_FOCUS)
+            return 0;
+    }
+    return n;
+}
+
+/// @brief Prints benchmark results to stdio as CSV, one line per benchmark, for comparing releases and variants of the code.
+/// The rate is of glyphs for the glyph benchmarks and of samples for the others, at the median time.
+/// @param variant Label of the build being measured
+/// @param results Results of Window_runBenchmarks
+/// @param n Number of results
+void Window_printBenchmarks(const char *variant, const WindowBenchResult *results, uint n)
+{
+    printf("version,variant,benchmark,samples,min_us,median_us,mean_us,p95_us,max_us,ops_per_s\n");
+    for (int i = 0; i < n; i++)
+    {
+        const WindowBenchResult *r = &results[i];
+        uint opsPerS = r->medianUs ? (uint64_t)r->opsPerSample * 1000000 / r->medianUs : 0;
+        printf("%s,%s,%s,%u,%u,%u,%u,%u,%u,%u\n", WINDOW_VER, variant, r->name, (uint)r->samples, (uint)r->minUs,
+               (uint)r->medianUs, (uint)r->meanUs, (uint)r->p95Us, (uint)r->maxUs, opsPerS);
+    }
+}
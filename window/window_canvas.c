@@ -0,0 +1,284 @@
+#include "pico/stdlib.h"
+#include "stdlib.h"
+#include "string.h"
+
+#include "window.h"
+#include "window_rtos.h"
+#include "window_pixel.h"
+
+// All canvas coordinates are relative to the top left corner of the window's content area,
+// and everything is clipped to it, leaving out the part a dialog covers. Pixels are written straight into the framebuffer.
+
+static inline void Canvas_setPixel(TermWindow *w, int x, int y, uint8_t col)
+{
+    Pixel_set(Pixel_row(w->yPos + y), w->xPos + x, col);
+}
+
+static inline bool Canvas_hiddenRow(TermWindow *w, int y)
+{
+    return w->hidden.width && y >= w->hidden.y && y < w->hidden.y + w->hidden.height;
+}
+
+static inline bool Canvas_inside(TermWindow *w, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= w->xRes || y >= w->yRes)
+        return false;
+    return !Canvas_hiddenRow(w, y) || x < w->hidden.x || x >= w->hidden.x + w->hidden.width;
+}
+
+/// @brief Fills a horizontal span, which must already be clipped. Whole bytes are filled at once,
+/// only pixels sharing a byte with pixels outside the span are set one by one.
+static void Canvas_fillSpan(TermWindow *w, int x0, int x1, int y, uint8_t col)
+{
+    while (x0 % FB_PIXELS_PER_BYTE && x0 <= x1)
+        Canvas_setPixel(w, x0++, y, col);
+    while ((x1 + 1) % FB_PIXELS_PER_BYTE && x1 >= x0)
+        Canvas_setPixel(w, x1--, y, col);
+    if (x1 >= x0)
+        memset(Pixel_pointer(w->xPos + x0, w->yPos + y), Pixel_fill(col), (x1 - x0 + 1) / FB_PIXELS_PER_BYTE);
+}
+
+/// @brief Fills the parts of a clipped horizontal span which are not under a dialog
+static void Canvas_span(TermWindow *w, int x0, int x1, int y, uint8_t col)
+{
+    if (!Canvas_hiddenRow(w, y) || x1 < w->hidden.x || x0 >= w->hidden.x + w->hidden.width)
+    {
+        Canvas_fillSpan(w, x0, x1, y, col);
+        return;
+    }
+    if (x0 < w->hidden.x)
+        Canvas_fillSpan(w, x0, w->hidden.x - 1, y, col);
+    if (x1 >= w->hidden.x + w->hidden.width)
+        Canvas_fillSpan(w, w->hidden.x + w->hidden.width, x1, y, col);
+}
+
+/// @brief Clips a rectangle to a window
+/// @return false if nothing of the rectangle is inside the window
+static bool Canvas_clip(TermWindow *w, int *x0, int *y0, int *x1, int *y1)
+{
+    if (*x0 < 0)
+        *x0 = 0;
+    if (*y0 < 0)
+        *y0 = 0;
+    if (*x1 >= (int)w->xRes)
+        *x1 = w->xRes - 1;
+    if (*y1 >= (int)w->yRes)
+        *y1 = w->yRes - 1;
+    if (*x0 > *x1 || *y0 > *y1)
+        return false;
+    return true;
+}
+
+/// @brief Draws a pixel in a window
+/// @param w Window to draw in
+/// @param x X coordinate, relative to the window
+/// @param y Y coordinate, relative to the window
+/// @param col Colour
+void Window_canvasPixel(TermWindow *w, int x, int y, uint8_t col)
+{
+    Window_beginDraw(w);
+    if (Canvas_inside(w, x, y))
+    {
+        Canvas_setPixel(w, x, y, col);
+        Window_markDamage(w, x, y, 1, 1);
+    }
+    Window_endDraw(w);
+}
+
+/// @brief Draws a horizontal line in a window
+/// @param w Window to draw in
+/// @param x X coordinate of the left end, relative to the window
+/// @param y Y coordinate, relative to the window
+/// @param len Length of the line
+/// @param col Colour
+void Window_canvasHLine(TermWindow *w, int x, int y, int len, uint8_t col)
+{
+    Window_canvasFillRect(w, x, y, len, 1, col);
+}
+
+/// @brief Draws a vertical line in a window
+/// @param w Window to draw in
+/// @param x X coordinate, relative to the window
+/// @param y Y coordinate of the top end, relative to the window
+/// @param len Length of the line
+/// @param col Colour
+void Window_canvasVLine(TermWindow *w, int x, int y, int len, uint8_t col)
+{
+    Window_canvasFillRect(w, x, y, 1, len, col);
+}
+
+/// @brief Draws a filled rectangle in a window
+/// @param w Window to draw in
+/// @param x X coordinate of the top left corner, relative to the window
+/// @param y Y coordinate of the top left corner, relative to the window
+/// @param width Width of the rectangle
+/// @param height Height of the rectangle
+/// @param col Colour
+void Window_canvasFillRect(TermWindow *w, int x, int y, int width, int height, uint8_t col)
+{
+    int x1 = x + width - 1;
+    int y1 = y + height - 1;
+    if (!Canvas_clip(w, &x, &y, &x1, &y1))
+        return;
+
+    Window_beginDraw(w);
+    for (int i = y; i <= y1; i++)
+        Canvas_span(w, x, x1, i, col);
+    Window_markDamage(w, x, y, x1 - x + 1, y1 - y + 1);
+    Window_endDraw(w);
+}
+
+/// @brief Draws the outline of a rectangle in a window
+/// @param w Window to draw in
+/// @param x X coordinate of the top left corner, relative to the window
+/// @param y Y coordinate of the top left corner, relative to the window
+/// @param width Width of the rectangle
+/// @param height Height of the rectangle
+/// @param col Colour
+void Window_canvasRect(TermWindow *w, int x, int y, int width, int height, uint8_t col)
+{
+    Window_canvasHLine(w, x, y, width, col);
+    Window_canvasHLine(w, x, y + height - 1, width, col);
+    Window_canvasVLine(w, x, y + 1, height - 2, col);
+    Window_canvasVLine(w, x + width - 1, y + 1, height - 2, col);
+}
+
+/// @brief Draws a line between two points in a window
+/// @param w Window to draw in
+/// @param x0 X coordinate of the first point, relative to the window
+/// @param y0 Y coordinate of the first point, relative to the window
+/// @param x1 X coordinate of the second point, relative to the window
+/// @param y1 Y coordinate of the second point, relative to the window
+/// @param col Colour
+void Window_canvasLine(TermWindow *w, int x0, int y0, int x1, int y1, uint8_t col)
+{
+    if (y0 == y1)
+    {
+        Window_canvasHLine(w, (x0 < x1) ? x0 : x1, y0, abs(x1 - x0) + 1, col);
+        return;
+    }
+    if (x0 == x1)
+    {
+        Window_canvasVLine(w, x0, (y0 < y1) ? y0 : y1, abs(y1 - y0) + 1, col);
+        return;
+    }
+
+    int bx0 = (x0 < x1) ? x0 : x1, bx1 = (x0 < x1) ? x1 : x0;
+    int by0 = (y0 < y1) ? y0 : y1, by1 = (y0 < y1) ? y1 : y0;
+    if (!Canvas_clip(w, &bx0, &by0, &bx1, &by1))
+        return;
+
+    Window_beginDraw(w);
+    int dx = abs(x1 - x0), sx = (x0 < x1) ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = (y0 < y1) ? 1 : -1;
+    int err = dx + dy;
+    while (true)
+    {
+        if (Canvas_inside(w, x0, y0))
+            Canvas_setPixel(w, x0, y0, col);
+        if (x0 == x1 && y0 == y1)
+            break;
+        int e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+    Window_markDamage(w, bx0, by0, bx1 - bx0 + 1, by1 - by0 + 1);
+    Window_endDraw(w);
+}
+
+/// @brief Draws the outline of a circle in a window
+/// @param w Window to draw in
+/// @param x0 X coordinate of the centre, relative to the window
+/// @param y0 Y coordinate of the centre, relative to the window
+/// @param r Radius
+/// @param col Colour
+void Window_canvasCircle(TermWindow *w, int x0, int y0, int r, uint8_t col)
+{
+    int bx0 = x0 - r, by0 = y0 - r, bx1 = x0 + r, by1 = y0 + r;
+    if (!Canvas_clip(w, &bx0, &by0, &bx1, &by1))
+        return;
+
+    Window_beginDraw(w);
+    int x = r, y = 0, err = 1 - r;
+    while (x >= y)
+    {
+        int px[8] = {x0 + x, x0 - x, x0 + x, x0 - x, x0 + y, x0 - y, x0 + y, x0 - y};
+        int py[8] = {y0 + y, y0 + y, y0 - y, y0 - y, y0 + x, y0 + x, y0 - x, y0 - x};
+        for (int i = 0; i < 8; i++)
+            if (Canvas_inside(w, px[i], py[i]))
+                Canvas_setPixel(w, px[i], py[i], col);
+
+        y++;
+        if (err < 0)
+            err += 2 * y + 1;
+        else
+        {
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+    Window_markDamage(w, bx0, by0, bx1 - bx0 + 1, by1 - by0 + 1);
+    Window_endDraw(w);
+}
+
+/// @brief Draws a filled circle in a window, as horizontal spans
+/// @param w Window to draw in
+/// @param x0 X coordinate of the centre, relative to the window
+/// @param y0 Y coordinate of the centre, relative to the window
+/// @param r Radius
+/// @param col Colour
+void Window_canvasFillCircle(TermWindow *w, int x0, int y0, int r, uint8_t col)
+{
+    int x = r, y = 0, err = 1 - r;
+    while (x >= y)
+    {
+        Window_canvasHLine(w, x0 - x, y0 + y, 2 * x + 1, col);
+        Window_canvasHLine(w, x0 - x, y0 - y, 2 * x + 1, col);
+        Window_canvasHLine(w, x0 - y, y0 + x, 2 * y + 1, col);
+        Window_canvasHLine(w, x0 - y, y0 - x, 2 * y + 1, col);
+
+        y++;
+        if (err < 0)
+            err += 2 * y + 1;
+        else
+        {
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+}
+
+/// @brief Draws text at any pixel position in a window, without a background. Does not move the window's text cursor.
+/// @param w Window to draw in
+/// @param x X coordinate of the top left corner of the first character, relative to the window
+/// @param y Y coordinate of the top left corner of the first character, relative to the window
+/// @param s String to draw
+/// @param size Text size
+/// @param col Colour
+void Window_canvasText(TermWindow *w, int x, int y, const char *s, uint size, uint8_t col)
+{
+    int len = strlen(s);
+    int bx0 = x, by0 = y, bx1 = x + FONT_WIDTH * size * len - 1, by1 = y + FONT_HEIGHT * size - 1;
+    if (len == 0 || !Canvas_clip(w, &bx0, &by0, &bx1, &by1))
+        return;
+
+    Window_beginDraw(w);
+    for (int i = 0; i < len; i++, x += FONT_WIDTH * size)
+    {
+        const uint8_t *glyph = Window_getGlyph(s[i]);
+        for (int row = 0; row < FONT_HEIGHT * size; row++)
+            for (int c = 0; c < FONT_WIDTH * size; c++)
+                if ((glyph[row / size] >> (c / size)) & 1 && Canvas_inside(w, x + c, y + row))
+                    Canvas_setPixel(w, x + c, y + row, col);
+    }
+    Window_markDamage(w, bx0, by0, bx1 - bx0 + 1, by1 - by0 + 1);
+    Window_endDraw(w);
+}
@@ -0,0 +1,42 @@
+#ifndef _WINDOW_CONFIG_H
+#define _WINDOW_CONFIG_H
+
+// Framebuffer geometry and pixel format. They have to match the display driver, and can be overridden
+// with compile definitions on the window library (FB_WIDTH=320, for example).
+#ifndef FB_WIDTH
+#define FB_WIDTH 640
+#endif
+
+#ifndef FB_HEIGHT
+#define FB_HEIGHT 480
+#endif
+
+// Bits per pixel: 3 packs two pixels into each byte (even pixel in bits 0-2, odd pixel in bits 3-5), 8 stores one pixel per byte
+#ifndef FB_BPP
+#define FB_BPP 3
+#endif
+
+#if FB_BPP == 3
+#define FB_PIXELS_PER_BYTE 2
+#elif FB_BPP == 8
+#define FB_PIXELS_PER_BYTE 1
+#else
+#error "FB_BPP must be 3 or 8"
+#endif
+
+#define FB_STRIDE (FB_WIDTH / FB_PIXELS_PER_BYTE)
+
+// Character cell of the GFX font
+#ifndef FONT_WIDTH
+#define FONT_WIDTH 6
+#endif
+
+#ifndef FONT_HEIGHT
+#define FONT_HEIGHT 8
+#endif
+
+#if FONT_WIDTH > 8 || FONT_WIDTH % FB_PIXELS_PER_BYTE
+#error "FONT_WIDTH must be at most 8 and a whole number of framebuffer bytes"
+#endif
+
+#endif
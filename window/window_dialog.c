@@ -0,0 +1,193 @@
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "vga.h"
+
+#include "window.h"
+#include "window_rtos.h"
+#include "window_pixel.h"
+
+// What a dialog covers: the framebuffer bytes under it, row after row, and the windows whose output is held back meanwhile
+static uint8_t *savedUnder;
+static uint savedXByte, savedY, savedRowBytes, savedHeight;
+static TermWindow *covered[MAX_WINDOWS];
+static uint nrCovered;
+static TermWindow *focusBefore;
+
+static uint32_t openLatency, closeLatency;
+
+// Held in modalWindow while a dialog is being opened, so that no other one can be opened meanwhile
+static uint8_t openingTag;
+#define DIALOG_OPENING ((TermWindow *)&openingTag)
+
+// Title bar above the content, as drawn by Window_initWindow
+#define DIALOG_TITLE_HEIGHT 10
+
+static bool Dialog_overlaps(TermWindow *w, int x, int y, int width, int height)
+{
+    // windows with their border and title bar
+    int wx = w->xPos - 2, wy = w->yPos - 12;
+    return wx < x + width && x < wx + (int)w->xRes + 4 && wy < y + height && y < wy + (int)w->yRes + 14;
+}
+
+static void Dialog_setModal(TermWindow *d)
+{
+    enterCritical();
+    modalWindow = d;
+    exitCritical();
+}
+
+/// @brief Starts drawing into a window (text output, canvas or image calls). While a dialog is opening, it waits for drawing
+/// in progress on the windows it covers; drawing which starts later sees the window's update and the covered part in w->hidden.
+/// @param w Window drawn in
+void Window_beginDraw(TermWindow *w)
+{
+    __sync_fetch_and_add(&w->drawing, 1);
+    __sync_synchronize(); // the dialog has to see the call before the call looks at what is hidden
+}
+
+/// @brief Ends drawing into a window
+/// @param w Window drawn in
+void Window_endDraw(TermWindow *w)
+{
+    __sync_synchronize(); // the pixels have to be written before the dialog saves the screen
+    __sync_fetch_and_sub(&w->drawing, 1);
+}
+
+/// @brief Opens a modal dialog: a window on top of the others, which has the focus until it is closed.
+/// The screen under it is saved and put back when it closes, and the windows under it are not drawn while it is open:
+/// their text output is kept and drawn when it closes, and their canvas and image drawing leaves out the part it covers.
+/// Only one dialog can be open at a time.
+/// @param xPos X coordinate of the dialog on screen
+/// @param yPos Y coordinate of the dialog on screen
+/// @param xSize Horizontal size of the dialog
+/// @param ySize Vertical size of the dialog
+/// @param name Title of the dialog
+/// @param borderCol Border colour of the dialog
+/// @return Pointer to the dialog's window, or NULL if a dialog is already open, its frame does not fit on the screen
+/// or there is no memory to save the screen under it
+TermWindow *Window_openDialog(uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol)
+{
+    uint32_t start = time_us_32();
+
+    // Claimed first, as everything below belongs to the one open dialog
+    enterCritical();
+    bool claimed = modalWindow == NULL;
+    if (claimed)
+        modalWindow = DIALOG_OPENING;
+    exitCritical();
+    if (!claimed)
+        return NULL;
+
+    // The area Window_initWindow draws on, with its alignment
+    uint x = xPos + (FB_PIXELS_PER_BYTE - xPos % FB_PIXELS_PER_BYTE) % FB_PIXELS_PER_BYTE;
+    uint width = xSize + (FB_PIXELS_PER_BYTE - xSize % FB_PIXELS_PER_BYTE) % FB_PIXELS_PER_BYTE + 4;
+    if (yPos < DIALOG_TITLE_HEIGHT || x + width > FB_WIDTH || yPos + ySize + 4 > FB_HEIGHT)
+    {
+        Dialog_setModal(NULL);
+        return NULL;
+    }
+    savedXByte = x / FB_PIXELS_PER_BYTE;
+    savedY = yPos - DIALOG_TITLE_HEIGHT;
+    savedRowBytes = FB_BYTES(width);
+    savedHeight = ySize + DIALOG_TITLE_HEIGHT + 4;
+
+    savedUnder = pvPortMalloc(savedRowBytes * savedHeight);
+    if (savedUnder == NULL)
+    {
+        Dialog_setModal(NULL);
+        return NULL;
+    }
+
+    takeWindowsSemaphore();
+    nrCovered = 0;
+    for (int i = 0; i < nrWindows; i++)
+    {
+        TermWindow *w = windowCarousel[i];
+        if (Dialog_overlaps(w, x, savedY, width, savedHeight))
+        {
+            Window_beginUpdate(w);
+            w->hidden = (WindowRect){x - w->xPos, savedY - w->yPos, savedRowBytes * FB_PIXELS_PER_BYTE, savedHeight};
+            covered[nrCovered++] = w;
+        }
+    }
+    focusBefore = activeWindow;
+    giveWindowsSemaphore();
+
+    // Drawing which started before the windows were covered ends up in the saved screen
+    __sync_synchronize();
+    for (int i = 0; i < nrCovered; i++)
+        while (covered[i]->drawing)
+            Window_taskYield();
+
+    for (int i = 0; i < savedHeight; i++)
+        Window_dmaCopy(savedUnder + i * savedRowBytes, Pixel_row(savedY + i) + savedXByte, savedRowBytes);
+
+    TermWindow *d = Window_createWindow(xPos, yPos, xSize, ySize, name, borderCol);
+    if (d == NULL)
+    {
+        for (int i = 0; i < nrCovered; i++)
+        {
+            covered[i]->hidden.width = 0;
+            Window_endUpdate(covered[i]);
+        }
+        vPortFree(savedUnder);
+        Dialog_setModal(NULL);
+        return NULL;
+    }
+    Window_clear(d);
+    Dialog_setModal(d);
+
+    openLatency = time_us_32() - start;
+    return d;
+}
+
+/// @brief Closes a dialog, puts back the screen under it and gives the focus back
+/// @param d Dialog to close
+void Window_closeDialog(TermWindow *d)
+{
+    uint32_t start = time_us_32();
+    if (d == NULL || d != modalWindow)
+        return;
+
+    // The dialog stays claimed until the screen under it is back
+    Window_release(d, false);
+
+    for (int i = 0; i < savedHeight; i++)
+        Window_dmaCopy(Pixel_row(savedY + i) + savedXByte, savedUnder + i * savedRowBytes, savedRowBytes);
+    Window_markScreenDamage(savedXByte * FB_PIXELS_PER_BYTE, savedY, savedRowBytes * FB_PIXELS_PER_BYTE, savedHeight);
+    vPortFree(savedUnder);
+
+    // Windows which were destroyed while the dialog was open are no longer in the list
+    takeWindowsSemaphore();
+    for (int i = 0; i < nrWindows; i++)
+    {
+        for (int j = 0; j < nrCovered; j++)
+            if (windowCarousel[i] == covered[j])
+            {
+                covered[j]->hidden.width = 0;
+                Window_endUpdate(covered[j]);
+            }
+        if (windowCarousel[i] == focusBefore)
+        {
+            takeKeySemaphore();
+            Window_setActiveWindow(focusBefore);
+            giveKeySemaphore();
+        }
+    }
+    giveWindowsSemaphore();
+    Dialog_setModal(NULL);
+
+    closeLatency = time_us_32() - start;
+}
+
+/// @brief Returns how long opening and closing the last dialog took, including saving and restoring the screen under it
+/// @param openUs where to store the opening time in microseconds
+/// @param closeUs where to store the closing time in microseconds
+void Window_getDialogLatency(uint32_t *openUs, uint32_t *closeUs)
+{
+    *openUs = openLatency;
+    *closeUs = closeLatency;
+}
@@ -0,0 +1,162 @@
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "window.h"
+#include "window_rtos.h"
+#include "window_pixel.h"
+
+// Damaged screen regions are merged when the merged region wastes at most this many pixels
+#define DISPLAY_MERGE_SLACK 256
+
+// The VGA output scans the framebuffer out continuously, so nothing has to be pushed
+const WindowDisplay Window_vgaDisplay = {NULL};
+
+static uint Display_memoryFlush(uint x, uint y, uint width, uint height)
+{
+    return FB_BYTES(width) * height;
+}
+
+// Framebuffer in memory only, without a panel. Flushing only counts the bytes a push would move, for measuring workloads.
+const WindowDisplay Window_memoryDisplay = {Display_memoryFlush};
+
+static const WindowDisplay *display = &Window_vgaDisplay;
+
+static WindowRect regions[DISPLAY_MAX_REGIONS];
+static uint nrRegions = 0;
+
+static uint32_t flushedFrames = 0;
+static uint32_t flushedBytes = 0;
+
+static inline int Display_area(WindowRect *r)
+{
+    return r->width * r->height;
+}
+
+static WindowRect Display_union(WindowRect *a, WindowRect *b)
+{
+    int x0 = (a->x < b->x) ? a->x : b->x;
+    int y0 = (a->y < b->y) ? a->y : b->y;
+    int x1 = (a->x + a->width > b->x + b->width) ? a->x + a->width : b->x + b->width;
+    int y1 = (a->y + a->height > b->y + b->height) ? a->y + a->height : b->y + b->height;
+    return (WindowRect){x0, y0, x1 - x0, y1 - y0};
+}
+
+/// @brief Adds a region to the list of damaged regions, merging it with the others where that wastes little
+static void Display_addRegion(WindowRect r)
+{
+    // Regions start and end on whole framebuffer bytes
+    r.width += r.x % FB_PIXELS_PER_BYTE;
+    r.x -= r.x % FB_PIXELS_PER_BYTE;
+    r.width = FB_BYTES(r.width) * FB_PIXELS_PER_BYTE;
+
+    int i = 0;
+    while (i < nrRegions)
+    {
+        WindowRect u = Display_union(&regions[i], &r);
+        if (Display_area(&u) <= Display_area(&regions[i]) + Display_area(&r) + DISPLAY_MERGE_SLACK)
+        {
+            // the merged region may now be worth merging with regions checked before
+            r = u;
+            regions[i] = regions[--nrRegions];
+            i = 0;
+        }
+        else
+            i++;
+    }
+
+    if (nrRegions < DISPLAY_MAX_REGIONS)
+    {
+        regions[nrRegions++] = r;
+        return;
+    }
+
+    // Out of regions: grow the one which grows the least
+    int best = 0, bestGrowth = -1;
+    for (i = 0; i < nrRegions; i++)
+    {
+        WindowRect u = Display_union(&regions[i], &r);
+        int growth = Display_area(&u) - Display_area(&regions[i]);
+        if (bestGrowth < 0 || growth < bestGrowth)
+        {
+            best = i;
+            bestGrowth = growth;
+        }
+    }
+    regions[best] = Display_union(&regions[best], &r);
+}
+
+/// @brief Marks a region of the screen as changed, for things drawn outside of windows (borders, titles)
+/// @param x X coordinate of the region
+/// @param y Y coordinate of the region
+/// @param width Width of the region
+/// @param height Height of the region
+void Window_markScreenDamage(int x, int y, int width, int height)
+{
+    if (display->flush == NULL)
+        return;
+
+    enterCritical();
+    Display_addRegion((WindowRect){x, y, width, height});
+    exitCritical();
+}
+
+/// @brief Selects the display backend the framebuffer is shown on
+/// @param d Display backend
+void Window_setDisplay(const WindowDisplay *d)
+{
+    display = d;
+}
+
+/// @brief Returns whether the display backend needs changed regions to be pushed to it
+bool Window_displayNeedsFlush()
+{
+    return display->flush != NULL;
+}
+
+/// @brief Pushes everything drawn since the last flush to the display, as a few merged regions.
+/// Called by the render task. Does nothing for displays which show the framebuffer directly.
+void Window_flushDisplay()
+{
+    // Nothing is shown while updates spanning several windows are open, windows in an update are held back
+    if (display->flush == NULL || updateGroups)
+        return;
+
+    WindowRect r;
+    for (int i = 0; i < nrWindows; i++)
+        if (!windowCarousel[i]->updateDepth && Window_takeDamage(windowCarousel[i], &r))
+            Window_markScreenDamage(windowCarousel[i]->xPos + r.x, windowCarousel[i]->yPos + r.y, r.width, r.height);
+
+    WindowRect frame[DISPLAY_MAX_REGIONS];
+    enterCritical();
+    uint n = nrRegions;
+    for (int i = 0; i < n; i++)
+        frame[i] = regions[i];
+    nrRegions = 0;
+    exitCritical();
+
+    if (n == 0)
+        return;
+
+    for (int i = 0; i < n; i++)
+    {
+        // clip to the screen
+        int x0 = (frame[i].x < 0) ? 0 : frame[i].x;
+        int y0 = (frame[i].y < 0) ? 0 : frame[i].y;
+        int x1 = (frame[i].x + frame[i].width > FB_WIDTH) ? FB_WIDTH : frame[i].x + frame[i].width;
+        int y1 = (frame[i].y + frame[i].height > FB_HEIGHT) ? FB_HEIGHT : frame[i].y + frame[i].height;
+        if (x1 > x0 && y1 > y0)
+            flushedBytes += display->flush(x0, y0, x1 - x0, y1 - y0);
+    }
+    flushedFrames++;
+}
+
+/// @brief Returns how much data was pushed to the display, to compare the cost of workloads
+/// @param frames where to store the number of flushes which pushed something
+/// @param bytes where to store the total number of bytes pushed
+void Window_getDisplayStats(uint32_t *frames, uint32_t *bytes)
+{
+    *frames = flushedFrames;
+    *bytes = flushedBytes;
+}
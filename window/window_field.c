@@ -0,0 +1,123 @@
+#include "pico/stdlib.h"
+#include "stdarg.h"
+#include "stdio.h"
+#include "string.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "window.h"
+#include "window_rtos.h"
+
+/// @brief Creates a dashboard: a set of labelled fields in a window, which are updated in place
+/// @param w Window the fields are in
+/// @param maxFields Maximum number of fields
+/// @return Pointer to the created dashboard, or NULL if there is not enough memory
+WindowDashboard *Window_createDashboard(TermWindow *w, uint maxFields)
+{
+    WindowDashboard *d = pvPortMalloc(sizeof(WindowDashboard));
+    if (d == NULL)
+        return NULL;
+    d->w = w;
+    d->fields = pvPortMalloc((maxFields ? maxFields : 1) * sizeof(WindowField));
+    if (d->fields == NULL)
+    {
+        vPortFree(d);
+        return NULL;
+    }
+    d->nrFields = 0;
+    d->maxFields = maxFields;
+    d->lastWake = xTaskGetTickCount();
+    d->updates = 0;
+    d->redrawn = 0;
+    return d;
+}
+
+/// @brief Adds a field to a dashboard and draws its label. The value starts blank, right after the label.
+/// The label and the value use the window's current colours and attributes.
+/// @param d Dashboard
+/// @param col Text column of the label
+/// @param row Text row of the label
+/// @param label Label of the field
+/// @param width Width of the value, in characters (at most FIELD_MAX_LEN)
+/// @return ID of the field, or -1 if it does not fit into the dashboard or the window
+int Window_addField(WindowDashboard *d, uint col, uint row, const char *label, uint width)
+{
+    TermWindow *w = d->w;
+    uint labelLen = strlen(label);
+    if (d->nrFields == d->maxFields || width > FIELD_MAX_LEN || row >= w->term_rows || col + labelLen + width > w->term_cols)
+        return -1;
+
+    WindowField *f = &d->fields[d->nrFields];
+    f->col = col + labelLen;
+    f->row = row;
+    f->width = width;
+    f->attr = WINDOW_ATTR(w->textCol, w->bgCol) | w->textAttr;
+
+    for (int i = 0; i < labelLen; i++)
+        Window_putCell(w, col + i, row, label[i], f->attr);
+    for (int i = 0; i < width; i++)
+    {
+        Window_putCell(w, f->col + i, row, ' ', f->attr);
+        f->shown[i] = ' ';
+    }
+
+    return d->nrFields++;
+}
+
+/// @brief Sets the value of a field. Only the characters which differ from what is shown are redrawn.
+/// Values are padded with spaces or cut to the width of the field.
+/// @param d Dashboard
+/// @param field ID of the field
+/// @param format Format string
+/// @return Number of characters redrawn, 0 (false) if the dashboard has no field with this ID
+uint Window_setField(WindowDashboard *d, int field, const char *format, ...)
+{
+    if (field < 0 || field >= d->nrFields)
+        return 0;
+
+    WindowField *f = &d->fields[field];
+    char value[FIELD_MAX_LEN + 1];
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(value, sizeof(value), format, args);
+    va_end(args);
+    if (len < 0)
+        len = 0;
+
+    uint redrawn = 0;
+    for (int i = 0; i < f->width; i++)
+    {
+        char c = (i < len) ? value[i] : ' ';
+        if (c != f->shown[i])
+        {
+            Window_putCell(d->w, f->col + i, f->row, c, f->attr);
+            f->shown[i] = c;
+            redrawn++;
+        }
+    }
+
+    d->updates++;
+    d->redrawn += redrawn;
+    return redrawn;
+}
+
+/// @brief Blocks until the next refresh period of a dashboard starts, for updating its fields at a fixed rate.
+/// Periods are counted from the previous one, so the time spent updating does not add up.
+/// @param d Dashboard
+/// @param ms Refresh period in milliseconds
+void Window_waitDashboardPeriod(WindowDashboard *d, uint ms)
+{
+    vTaskDelayUntil(&d->lastWake, ms / portTICK_PERIOD_MS);
+}
+
+/// @brief Returns how much work updating the fields of a dashboard took
+/// @param d Dashboard
+/// @param updates where to store the number of field updates
+/// @param redrawn where to store the number of characters redrawn by them
+void Window_getDashboardStats(WindowDashboard *d, uint32_t *updates, uint32_t *redrawn)
+{
+    *updates = d->updates;
+    *redrawn = d->redrawn;
+}
@@ -0,0 +1,171 @@
+#include "pico/stdlib.h"
+#include "string.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "vga.h"
+#include "gfx.h"
+
+#include "window.h"
+#include "window_rtos.h"
+#include "window_pixel.h"
+
+#define FONT_CHARS 256
+#define FONT_PER_ROW (FB_WIDTH / FONT_WIDTH)
+#define FONT_ROW_PATTERNS (1 << FONT_WIDTH)
+#define FONT_ROW_BYTES (FONT_WIDTH / FB_PIXELS_PER_BYTE)
+#define FONT_UNDERLINE (FONT_ROW_PATTERNS - 1)
+
+// Glyph bitmaps of the GFX font, one byte per pixel row, bit n being pixel column n
+static uint8_t glyphRows[FONT_CHARS][FONT_HEIGHT];
+
+// Framebuffer bytes for each cell attribute and group of glyph pixels sharing a byte (bit n set = pixel n of the byte lit)
+static uint8_t attrPatterns[256][1 << FB_PIXELS_PER_BYTE];
+
+// Pre-scaled glyph rows for each text size in use. For every possible glyph row, the table holds the pixel groups
+// of the scaled row, as indexes into attrPatterns, so scaled text is drawn with one lookup per byte.
+static uint8_t *scaledRows[MAX_TEXT_SIZE + 1];
+
+static void Glyph_buildPatterns()
+{
+    for (int a = 0; a < 256; a++)
+    {
+        uint8_t fg = a & 7;
+        uint8_t bg = (a >> 3) & 7;
+        if (a & ATTR_INVERSE)
+        {
+            uint8_t t = fg;
+            fg = bg;
+            bg = t;
+        }
+        for (int bits = 0; bits < (1 << FB_PIXELS_PER_BYTE); bits++)
+        {
+            uint8_t b = 0;
+            for (int i = 0; i < FB_PIXELS_PER_BYTE; i++)
+                Pixel_set(&b, i, ((bits >> i) & 1) ? fg : bg);
+            attrPatterns[a][bits] = b;
+        }
+    }
+}
+
+/// @brief Captures the GFX font into the glyph table, by drawing every character and reading it back from the framebuffer.
+/// This overwrites the top of the screen, so it has to be done before the screen is cleared.
+void Window_loadFont()
+{
+    VGA_fillScreen(BLACK);
+    GFX_setTextSize(1);
+    GFX_setTextColor(WHITE);
+
+    for (int c = 0; c < FONT_CHARS; c++)
+    {
+        if (c == '\n' || c == '\r')
+            continue;
+        GFX_setCursor((c % FONT_PER_ROW) * FONT_WIDTH, (c / FONT_PER_ROW) * FONT_HEIGHT);
+        GFX_write(c);
+    }
+
+    for (int c = 0; c < FONT_CHARS; c++)
+    {
+        uint x = (c % FONT_PER_ROW) * FONT_WIDTH;
+        uint y = (c / FONT_PER_ROW) * FONT_HEIGHT;
+        for (int row = 0; row < FONT_HEIGHT; row++)
+        {
+            glyphRows[c][row] = 0;
+            for (int col = 0; col < FONT_WIDTH; col++)
+                if (Pixel_get(Pixel_row(y + row), x + col) != BLACK)
+                    glyphRows[c][row] |= 1 << col;
+        }
+    }
+
+    Glyph_buildPatterns();
+}
+
+/// @brief Returns the bitmap of a character: FONT_HEIGHT rows, bit n of each being pixel column n
+/// @param c Character
+/// @return Pointer to the glyph rows
+const uint8_t *Window_getGlyph(unsigned char c)
+{
+    return glyphRows[c];
+}
+
+/// @brief Builds the pre-scaled glyph rows for a text size, if they don't exist yet
+/// @param s Text size
+/// @return false if there is not enough memory for them
+bool Window_prepareGlyphSize(uint s)
+{
+    if (s < 2 || scaledRows[s] != NULL)
+        return true;
+
+    uint scaledBytes = FONT_ROW_BYTES * s;
+    uint8_t *scaled = pvPortMalloc(FONT_ROW_PATTERNS * scaledBytes);
+    if (scaled == NULL)
+        return false;
+    for (int bits = 0; bits < FONT_ROW_PATTERNS; bits++)
+        for (int i = 0; i < scaledBytes; i++)
+        {
+            uint8_t group = 0;
+            for (int p = 0; p < FB_PIXELS_PER_BYTE; p++)
+                group |= ((bits >> ((FB_PIXELS_PER_BYTE * i + p) / s)) & 1) << p;
+            scaled[scaledBytes * bits + i] = group;
+        }
+
+    // Another task may have built the same size in the meantime, possibly on the other core
+    enterCritical();
+    if (scaledRows[s] == NULL)
+    {
+        scaledRows[s] = scaled;
+        scaled = NULL;
+    }
+    exitCritical();
+    if (scaled != NULL)
+        vPortFree(scaled);
+    return true;
+}
+
+/// @brief Draws a character into a text cell of a window, with the colours and attributes given by attr.
+/// Every pixel of the cell is written, so no clearing is needed beforehand.
+/// @param w Window to draw into
+/// @param col Text column of the cell
+/// @param row Text row of the cell
+/// @param c Character to draw
+/// @param attr Cell attributes
+void Window_drawGlyph(TermWindow *w, uint col, uint row, unsigned char c, uint8_t attr)
+{
+    uint s = w->textSize;
+    uint8_t *pattern = attrPatterns[attr];
+    uint8_t *dst = Pixel_pointer(w->xPos + FONT_WIDTH * s * col, w->yPos + FONT_HEIGHT * s * row + 1);
+
+    if (s == 1)
+    {
+        for (int y = 0; y < FONT_HEIGHT; y++)
+        {
+            uint8_t bits = (y == FONT_HEIGHT - 1 && (attr & ATTR_UNDERLINE)) ? FONT_UNDERLINE : glyphRows[c][y];
+            for (int i = 0; i < FONT_ROW_BYTES; i++)
+                dst[i] = pattern[(bits >> (FB_PIXELS_PER_BYTE * i)) & FB_PIXEL_MASK];
+            dst += FB_STRIDE;
+        }
+    }
+    else
+    {
+        // Scaled glyphs: each row is expanded once from the cache, then repeated s times
+        uint scaledBytes = FONT_ROW_BYTES * s;
+        uint8_t *scaled = scaledRows[s];
+        uint8_t line[FONT_ROW_BYTES * MAX_TEXT_SIZE];
+        for (int y = 0; y < FONT_HEIGHT; y++)
+        {
+            uint8_t bits = (y == FONT_HEIGHT - 1 && (attr & ATTR_UNDERLINE)) ? FONT_UNDERLINE : glyphRows[c][y];
+            uint8_t *groups = scaled + scaledBytes * bits;
+            for (int i = 0; i < scaledBytes; i++)
+                line[i] = pattern[groups[i]];
+            for (int j = 0; j < s; j++)
+            {
+                memcpy(dst, line, scaledBytes);
+                dst += FB_STRIDE;
+            }
+        }
+    }
+
+    // Marked once the pixels are written, so that a flush taking the damage meanwhile cannot miss them
+    Window_markDamage(w, FONT_WIDTH * s * col, FONT_HEIGHT * s * row + 1, FONT_WIDTH * s, FONT_HEIGHT * s);
+}
@@ -0,0 +1,123 @@
+#include "pico/stdlib.h"
+#include "string.h"
+
+#include "vga.h"
+
+#include "window.h"
+#include "window_rtos.h"
+#include "window_pixel.h"
+
+// Rows at least this long are copied with DMA, shorter ones are cheaper to copy with the CPU
+#define BLIT_DMA_MIN_BYTES 32
+
+/// @brief Copies pixels j to end - 1 of an image row into a window row
+/// @param dstX Position of the first pixel within its framebuffer byte
+/// @param transparent Colour which is not drawn, or -1 to draw every pixel
+static void Image_row(uint8_t *dst, int dstX, const uint8_t *src, int srcX, int j, int end, int transparent)
+{
+    uint8_t key = transparent;
+
+    // When source and destination pixels sit at the same place within their bytes, rows are copied as whole bytes
+    if (dstX == srcX % FB_PIXELS_PER_BYTE && transparent < 0)
+    {
+        while ((dstX + j) % FB_PIXELS_PER_BYTE && j < end)
+        {
+            Pixel_set(dst, dstX + j, Pixel_get(src, srcX + j));
+            j++;
+        }
+
+        uint n = (end - j) / FB_PIXELS_PER_BYTE;
+        uint8_t *d = dst + (dstX + j) / FB_PIXELS_PER_BYTE;
+        const uint8_t *s = src + (srcX + j) / FB_PIXELS_PER_BYTE;
+        if (n >= BLIT_DMA_MIN_BYTES)
+            Window_dmaCopy(d, s, n);
+        else
+            memcpy(d, s, n);
+
+        for (j += n * FB_PIXELS_PER_BYTE; j < end; j++)
+            Pixel_set(dst, dstX + j, Pixel_get(src, srcX + j));
+    }
+    else
+    {
+        // Otherwise pixels are moved one at a time, skipping the transparent colour
+        for (; j < end; j++)
+        {
+            uint8_t col = Pixel_get(src, srcX + j);
+            if (transparent < 0 || col != key)
+                Pixel_set(dst, dstX + j, col);
+        }
+    }
+}
+
+/// @brief Copies a clipped part of an image into a window, leaving out the part a dialog covers
+/// @param transparent Colour which is not drawn, or -1 to draw every pixel
+static void Image_blit(TermWindow *w, const WindowImage *img, int x, int y, int transparent)
+{
+    // Clip to the window, keeping track of where the visible part starts in the image
+    int srcX = 0, srcY = 0;
+    int width = img->width, height = img->height;
+    if (x < 0)
+    {
+        srcX = -x;
+        width += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        srcY = -y;
+        height += y;
+        y = 0;
+    }
+    if (x + width > (int)w->xRes)
+        width = w->xRes - x;
+    if (y + height > (int)w->yRes)
+        height = w->yRes - y;
+    if (width <= 0 || height <= 0)
+        return;
+
+    Window_beginDraw(w);
+    uint rowBytes = FB_BYTES(img->width);
+    const uint8_t *src = img->data + rowBytes * srcY;
+    uint8_t *dst = Pixel_pointer(w->xPos + x, w->yPos + y);
+    int dstX = x % FB_PIXELS_PER_BYTE;
+
+    for (int i = 0; i < height; i++, src += rowBytes, dst += FB_STRIDE)
+    {
+        WindowRect h = w->hidden;
+        int hiddenFrom = h.x - x, hiddenTo = h.x + h.width - x;
+        if (!h.width || y + i < h.y || y + i >= h.y + h.height || hiddenTo <= 0 || hiddenFrom >= width)
+            Image_row(dst, dstX, src, srcX, 0, width, transparent);
+        else
+        {
+            if (hiddenFrom > 0)
+                Image_row(dst, dstX, src, srcX, 0, hiddenFrom, transparent);
+            if (hiddenTo < width)
+                Image_row(dst, dstX, src, srcX, hiddenTo, width, transparent);
+        }
+    }
+
+    // Marked once the pixels are written, so that a flush taking the damage meanwhile cannot miss them
+    Window_markDamage(w, x, y, width, height);
+    Window_endDraw(w);
+}
+
+/// @brief Draws an image into a window, clipped to the window
+/// @param w Window to draw in
+/// @param img Image to draw
+/// @param x X coordinate of the top left corner of the image, relative to the window
+/// @param y Y coordinate of the top left corner of the image, relative to the window
+void Window_blit(TermWindow *w, const WindowImage *img, int x, int y)
+{
+    Image_blit(w, img, x, y, -1);
+}
+
+/// @brief Draws an image into a window, clipped to the window, leaving the pixels of one colour out
+/// @param w Window to draw in
+/// @param img Image to draw
+/// @param x X coordinate of the top left corner of the image, relative to the window
+/// @param y Y coordinate of the top left corner of the image, relative to the window
+/// @param transparent Colour to leave out
+void Window_blitTransparent(TermWindow *w, const WindowImage *img, int x, int y, uint8_t transparent)
+{
+    Image_blit(w, img, x, y, transparent);
+}
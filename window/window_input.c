@@ -3,53 +3,290 @@
 #include "stdio.h"
 #include "string.h"
 
+#include "FreeRTOS.h"
+#include "queue.h"
+
 #include "window.h"
 #include "window_rtos.h"
 
-/// @brief Gets a single character from specified window input, blocks if there are no characters to be read or if the window is not active
+/// @brief Gets a single character from specified window input, blocks if there are no characters to be read. Keys only reach a window while it is in focus.
 /// @param w Window from which to get input
 /// @return Read character
 char Window_getchar(TermWindow *w)
 {
-    while (w != activeWindow || !kbKeys)
-        Window_taskYield();
+    char c;
+    xQueueReceive(w->keyQueue, &c, portMAX_DELAY);
+    Window_checkExit(w);
+    return c;
+}
 
-    takeKeySemaphore();
-    char c = kbBuf[0];
-    kbKeys--;
-    memcpy(kbBuf, kbBuf + 1, kbKeys);
-    giveKeySemaphore();
+/// @brief Gets a single character from specified window input, without blocking
+/// @param w Window from which to get input
+/// @param c where to store the read character
+/// @return true if a character was read, false if there were none waiting
+bool Window_tryGetchar(TermWindow *w, char *c)
+{
+    Window_checkExit(w);
+    return xQueueReceive(w->keyQueue, c, 0) == pdTRUE;
+}
 
-    return c;
+/// @brief Returns the number of keypresses waiting to be read from specified window
+/// @param w window
+/// @return number of waiting keypresses
+uint Window_keysAvailable(TermWindow *w)
+{
+    return uxQueueMessagesWaiting(w->keyQueue);
+}
+
+/// @brief Creates a set of event sources (windows and queues) which can be waited on together
+/// @param length Sum of the lengths of all queues to be added. Each window counts as KEYBUF_LEN.
+/// @return Pointer to the created event set
+WindowEventSet *Window_createEventSet(uint length)
+{
+    WindowEventSet *s = pvPortMalloc(sizeof(WindowEventSet));
+    s->set = xQueueCreateSet(length);
+    s->nrSources = 0;
+    return s;
+}
+
+/// @brief Adds a queue to an event set. The queue must be empty when it is added and can only belong to one set.
+/// @param s Event set
+/// @param q Queue to add
+/// @return Source ID of the queue within the set, or -1 if it could not be added
+int Window_addQueueToEventSet(WindowEventSet *s, QueueHandle_t q)
+{
+    if (s->nrSources == MAX_EVENT_SOURCES || xQueueAddToSet(q, s->set) != pdPASS)
+        return -1;
+
+    s->sources[s->nrSources] = q;
+    return s->nrSources++;
+}
+
+/// @brief Adds the keyboard input of a window to an event set. The window must have no keypresses waiting when it is added.
+/// @param s Event set
+/// @param w Window to add
+/// @return Source ID of the window within the set, or -1 if it could not be added
+int Window_addWindowToEventSet(WindowEventSet *s, TermWindow *w)
+{
+    return Window_addQueueToEventSet(s, w->keyQueue);
+}
+
+/// @brief Blocks until one of the sources in an event set is ready. After each returned event, exactly one item has to be read from that source
+/// (with Window_tryGetchar for windows, or xQueueReceive for queues).
+/// @param s Event set to wait on
+/// @param ms Timeout in milliseconds, 0 to poll or WINDOW_WAIT_FOREVER to wait indefinitely
+/// @return Source ID of the ready source, or -1 on timeout
+int Window_waitEvent(WindowEventSet *s, uint ms)
+{
+    TickType_t ticks = (ms == WINDOW_WAIT_FOREVER) ? portMAX_DELAY : ms / portTICK_PERIOD_MS;
+    QueueSetMemberHandle_t ready = xQueueSelectFromSet(s->set, ticks);
+
+    for (int i = 0; i < s->nrSources; i++)
+        if (s->sources[i] == ready)
+            return i;
+
+    return -1;
 }
 
-/// @brief Reads a string from specified window
+// State of the line being edited by Window_readLine
+typedef struct LineEdit
+{
+    TermWindow *w;
+    char *buf;
+    uint len, max;    // length of the line, and the most it may hold
+    uint pos;         // editing cursor
+    uint start;       // cell of the first character, counted from the top left of the window
+    uint8_t attr;
+
+} LineEdit;
+
+/// @brief Scrolls the window until the cell of a character of the line is visible
+static void Edit_reveal(LineEdit *e, uint i)
+{
+    TermWindow *w = e->w;
+    while (e->start + i >= w->term_rows * w->term_cols && e->start >= w->term_cols)
+    {
+        Window_scrollLines(w, 1);
+        e->start -= w->term_cols;
+    }
+}
+
+/// @brief Redraws the cells of characters from to to - 1 of the line. Cells past its end are blanked, and the editing cursor is drawn inverted.
+static void Edit_redraw(LineEdit *e, uint from, uint to)
+{
+    TermWindow *w = e->w;
+    Edit_reveal(e, (to > from) ? to - 1 : from);
+    for (uint i = from; i < to; i++)
+    {
+        uint cell = e->start + i;
+        char c = (i < e->len) ? e->buf[i] : ' ';
+        Window_putCell(w, cell % w->term_cols, cell / w->term_cols, c, (i == e->pos) ? e->attr ^ ATTR_INVERSE : e->attr);
+    }
+}
+
+static inline char *Edit_historyLine(WindowHistory *h, uint back)
+{
+    return h->lines + ((h->next + h->entries - back) % h->entries) * HISTORY_LINE_LEN;
+}
+
+/// @brief Replaces the line being edited, redrawing from the first character which changed
+static void Edit_replace(LineEdit *e, const char *s)
+{
+    uint oldLen = e->len;
+    uint first = 0;
+    while (first < e->len && e->buf[first] == s[first])
+        first++;
+
+    e->len = 0;
+    while (s[e->len] && e->len < e->max)
+    {
+        e->buf[e->len] = s[e->len];
+        e->len++;
+    }
+    e->buf[e->len] = '\0';
+
+    uint oldPos = e->pos;
+    e->pos = e->len;
+    if (oldPos < first)
+        Edit_redraw(e, oldPos, oldPos + 1);
+    Edit_redraw(e, first, ((oldLen > e->len) ? oldLen : e->len) + 1);
+}
+
+/// @brief Reads a line from specified window, with editing: the arrow keys move within the line and through the history,
+/// typed characters are inserted at the cursor and backspace deletes before it. Only the part of the line which changes is redrawn.
 /// @param w Window from which to get input
-/// @param termScanBuf array to read characters into
-void Window_readString(TermWindow *w, char termScanBuf[])
+/// @param buf Buffer to read the line into
+/// @param len Size of the buffer. Longer lines are not accepted.
+/// @return Length of the line
+uint Window_readLine(TermWindow *w, char *buf, uint len)
 {
-    termScanBuf[0] = '\0';
+    if (len == 0)
+        return 0;
+
+    LineEdit e = {w, buf, 0, len - 1, 0, w->currentRow * w->term_cols + w->currentCol, WINDOW_ATTR(w->textCol, w->bgCol) | w->textAttr};
+    if (e.max >= w->term_rows * w->term_cols - w->currentCol)
+        e.max = w->term_rows * w->term_cols - w->currentCol - 1;
+    buf[0] = '\0';
+
+    // Lines from the history are edited in place of the line being typed, which is kept to come back to
+    WindowHistory *h = w->history;
+    char typed[HISTORY_LINE_LEN];
+    uint back = 0;
+
+    Edit_redraw(&e, 0, 1);
     char c = Window_getchar(w);
-    int i = 0;
     while (c != PS2_ENTER)
     {
-        if (c == PS2_BACKSPACE)
+        switch (c)
         {
-            if (i > 0)
+        case PS2_LEFTARROW:
+            if (e.pos > 0)
             {
-                termScanBuf[i--] = '\0';
-                Window_write(w, c);
+                e.pos--;
+                Edit_redraw(&e, e.pos, e.pos + 2);
             }
-        }
-        else
-        {
-            termScanBuf[i++] = c;
-            termScanBuf[i] = '\0';
-            Window_write(w, c);
+            break;
+
+        case PS2_RIGHTARROW:
+            if (e.pos < e.len)
+            {
+                e.pos++;
+                Edit_redraw(&e, e.pos - 1, e.pos + 1);
+            }
+            break;
+
+        case PS2_BACKSPACE:
+            if (e.pos > 0)
+            {
+                memmove(buf + e.pos - 1, buf + e.pos, e.len - e.pos + 1);
+                e.pos--;
+                e.len--;
+                Edit_redraw(&e, e.pos, e.len + 2);
+            }
+            break;
+
+        case PS2_UPARROW:
+            if (h != NULL && back < h->count && back < h->entries)
+            {
+                if (back == 0)
+                {
+                    strncpy(typed, buf, HISTORY_LINE_LEN - 1);
+                    typed[HISTORY_LINE_LEN - 1] = '\0';
+                }
+                back++;
+                Edit_replace(&e, Edit_historyLine(h, back));
+            }
+            break;
+
+        case PS2_DOWNARROW:
+            if (back > 0)
+            {
+                back--;
+                Edit_replace(&e, back ? Edit_historyLine(h, back) : typed);
+            }
+            break;
+
+        default:
+            if (c >= ' ' && c < PS2_DELETE && e.len < e.max)
+            {
+                memmove(buf + e.pos + 1, buf + e.pos, e.len - e.pos + 1);
+                buf[e.pos] = c;
+                e.pos++;
+                e.len++;
+                Edit_redraw(&e, e.pos - 1, e.len + 1);
+            }
+            break;
         }
         c = Window_getchar(w);
     }
+
+    // Remove the editing cursor and continue on the next row
+    e.pos = e.len + 1;
+    Edit_redraw(&e, e.len, e.len + 1);
+    Window_setCursor(w, (e.start + e.len) % w->term_cols, (e.start + e.len) / w->term_cols);
     Window_write(w, '\n');
+
+    if (h != NULL && e.len && (h->count == 0 || strncmp(Edit_historyLine(h, 1), buf, HISTORY_LINE_LEN - 1)))
+    {
+        strncpy(h->lines + h->next * HISTORY_LINE_LEN, buf, HISTORY_LINE_LEN - 1);
+        h->lines[h->next * HISTORY_LINE_LEN + HISTORY_LINE_LEN - 1] = '\0';
+        h->next = (h->next + 1) % h->entries;
+        h->count++;
+    }
+
+    return e.len;
+}
+
+/// @brief Keeps the lines entered with Window_readLine in a window, to be recalled with the up and down arrows
+/// @param w Window
+/// @param entries Number of lines kept, at least 1
+/// @return false if entries is 0 or there is not enough memory, leaving the window without a history
+bool Window_enableHistory(TermWindow *w, uint entries)
+{
+    if (entries == 0)
+        return false;
+    WindowHistory *h = pvPortMalloc(sizeof(WindowHistory));
+    if (h == NULL)
+        return false;
+    h->lines = pvPortMalloc(entries * HISTORY_LINE_LEN);
+    if (h->lines == NULL)
+    {
+        vPortFree(h);
+        return false;
+    }
+    h->entries = entries;
+    h->count = 0;
+    h->next = 0;
+    w->history = h;
+    return true;
+}
+
+/// @brief Reads a string from specified window, with line editing (see Window_readLine)
+/// @param w Window from which to get input
+/// @param termScanBuf array of at least READ_STRING_LEN characters to read into
+void Window_readString(TermWindow *w, char termScanBuf[])
+{
+    Window_readLine(w, termScanBuf, READ_STRING_LEN);
 }
 
 /// @brief Reads formatted data from specified window
@@ -0,0 +1,401 @@
+#include "pico/stdlib.h"
+#include "string.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "window.h"
+#include "window_rtos.h"
+#include "window_pixel.h"
+
+#include "gfx.h"
+
+// Space taken around a window's content: the title bar above it and a border of 2 pixels on each side.
+// Window_initWindow puts the title bar at yPos, 10 pixels above the border.
+#define LAYOUT_FRAME_WIDTH 4
+#define LAYOUT_FRAME_HEIGHT 14
+#define LAYOUT_TITLE_HEIGHT 10
+
+// Weights are kept in a byte
+#define LAYOUT_MAX_WEIGHT 255
+
+// Smallest content area a slot must leave, one text row and a few columns
+#define LAYOUT_MIN_WIDTH (4 * FONT_WIDTH)
+#define LAYOUT_MIN_HEIGHT (2 * FONT_HEIGHT)
+
+/// @brief Initializes a layout covering an area of the screen. Its root stacks what is added to it as rows.
+/// @param l Layout to initialize
+/// @param x X coordinate of the area
+/// @param y Y coordinate of the area
+/// @param width Width of the area
+/// @param height Height of the area
+void Window_initLayout(WindowLayout *l, uint x, uint y, uint width, uint height)
+{
+    l->area = (WindowRect){x, y, width, height};
+    l->nodes[LAYOUT_ROOT] = (WindowLayoutNode){LAYOUT_ROWS, LAYOUT_ROOT, 1, 0, l->area, NULL};
+    l->nrNodes = 1;
+}
+
+static inline uint8_t Layout_weight(uint weight)
+{
+    if (weight == 0)
+        return 1;
+    return (weight > LAYOUT_MAX_WEIGHT) ? LAYOUT_MAX_WEIGHT : weight;
+}
+
+static int Layout_add(WindowLayout *l, int parent, WindowLayoutType type, uint weight, uint gridCols)
+{
+    if (l->nrNodes == MAX_LAYOUT_NODES || parent < 0 || parent >= l->nrNodes || l->nodes[parent].type == LAYOUT_SLOT)
+        return -1;
+
+    l->nodes[l->nrNodes] = (WindowLayoutNode){type, parent, Layout_weight(weight), gridCols, {0, 0, 0, 0}, NULL};
+    return l->nrNodes++;
+}
+
+/// @brief Adds a split to a layout, which divides its space between its children by their weights
+/// @param l Layout
+/// @param parent Node to add the split to
+/// @param type LAYOUT_ROWS or LAYOUT_COLUMNS
+/// @param weight Share of the parent's space, from 1 to 255
+/// @return Node of the split, or -1 if the layout is full
+int Window_addLayoutSplit(WindowLayout *l, int parent, WindowLayoutType type, uint weight)
+{
+    return Layout_add(l, parent, type, weight, 0);
+}
+
+/// @brief Adds a grid to a layout, which places its children in equal cells, filling rows of cols cells
+/// @param l Layout
+/// @param parent Node to add the grid to
+/// @param cols Number of columns
+/// @param weight Share of the parent's space, from 1 to 255
+/// @return Node of the grid, or -1 if the layout is full
+int Window_addLayoutGrid(WindowLayout *l, int parent, uint cols, uint weight)
+{
+    return Layout_add(l, parent, LAYOUT_GRID, weight, cols ? cols : 1);
+}
+
+/// @brief Adds a place for a window to a layout
+/// @param l Layout
+/// @param parent Node to add the slot to
+/// @param weight Share of the parent's space, from 1 to 255
+/// @return Node of the slot, or -1 if the layout is full
+int Window_addLayoutSlot(WindowLayout *l, int parent, uint weight)
+{
+    return Layout_add(l, parent, LAYOUT_SLOT, weight, 0);
+}
+
+/// @brief Returns where the edge number num of den equal parts of a span falls, weighted. Horizontal edges fall on whole framebuffer bytes.
+static int Layout_edge(int start, int len, uint num, uint den, bool horizontal)
+{
+    if (num >= den)
+        return start + len;
+    int edge = start + (len * num) / den;
+    if (horizontal)
+        edge -= edge % FB_PIXELS_PER_BYTE;
+    return edge;
+}
+
+static void Layout_place(WindowLayout *l, int node, WindowRect r)
+{
+    WindowLayoutNode *n = &l->nodes[node];
+    n->rect = r;
+    if (n->type == LAYOUT_SLOT)
+        return;
+
+    uint count = 0, total = 0;
+    for (int i = node + 1; i < l->nrNodes; i++)
+        if (l->nodes[i].parent == node)
+        {
+            count++;
+            total += l->nodes[i].weight;
+        }
+    if (count == 0)
+        return;
+
+    uint gridRows = (n->type == LAYOUT_GRID) ? (count + n->gridCols - 1) / n->gridCols : 0;
+    uint k = 0, before = 0;
+    for (int i = node + 1; i < l->nrNodes; i++)
+    {
+        WindowLayoutNode *c = &l->nodes[i];
+        if (c->parent != node)
+            continue;
+
+        int x0 = r.x, x1 = r.x + r.width, y0 = r.y, y1 = r.y + r.height;
+        if (n->type == LAYOUT_ROWS)
+        {
+            y0 = Layout_edge(r.y, r.height, before, total, false);
+            y1 = Layout_edge(r.y, r.height, before + c->weight, total, false);
+        }
+        else if (n->type == LAYOUT_COLUMNS)
+        {
+            x0 = Layout_edge(r.x, r.width, before, total, true);
+            x1 = Layout_edge(r.x, r.width, before + c->weight, total, true);
+        }
+        else
+        {
+            uint col = k % n->gridCols, row = k / n->gridCols;
+            x0 = Layout_edge(r.x, r.width, col, n->gridCols, true);
+            x1 = Layout_edge(r.x, r.width, col + 1, n->gridCols, true);
+            y0 = Layout_edge(r.y, r.height, row, gridRows, false);
+            y1 = Layout_edge(r.y, r.height, row + 1, gridRows, false);
+        }
+        before += c->weight;
+        k++;
+        Layout_place(l, i, (WindowRect){x0, y0, x1 - x0, y1 - y0});
+    }
+}
+
+/// @brief Converts the area of a slot to the arguments of Window_initWindow, so that the window's frame fills the slot
+static void Layout_frame(WindowRect *r, uint *xPos, uint *yPos, uint *xSize, uint *ySize)
+{
+    *xPos = r->x + r->x % FB_PIXELS_PER_BYTE;
+    *yPos = r->y + LAYOUT_TITLE_HEIGHT;
+    uint right = r->x + r->width;
+    right -= right % FB_PIXELS_PER_BYTE;
+    *xSize = right - *xPos - LAYOUT_FRAME_WIDTH;
+    *ySize = r->height - LAYOUT_FRAME_HEIGHT;
+}
+
+/// @brief Computes the area of every node
+/// @return false if a slot is too small to hold a window
+static bool Layout_compute(WindowLayout *l)
+{
+    Layout_place(l, LAYOUT_ROOT, l->area);
+    for (int i = 0; i < l->nrNodes; i++)
+    {
+        WindowRect *r = &l->nodes[i].rect;
+        if (l->nodes[i].type == LAYOUT_SLOT &&
+            (r->width < LAYOUT_MIN_WIDTH + LAYOUT_FRAME_WIDTH + FB_PIXELS_PER_BYTE || r->height < LAYOUT_MIN_HEIGHT + LAYOUT_FRAME_HEIGHT))
+            return false;
+    }
+    return true;
+}
+
+/// @brief Creates a window filling a slot of a layout
+/// @param l Layout
+/// @param slot Slot to place the window in
+/// @param name Name of the window
+/// @param borderCol Border colour of the window
+/// @return Pointer to the created window, or NULL if the slot is too small or MAX_WINDOWS windows already exist
+TermWindow *Window_createLayoutWindow(WindowLayout *l, int slot, char name[], uint8_t borderCol)
+{
+    if (slot < 0 || slot >= l->nrNodes || l->nodes[slot].type != LAYOUT_SLOT || !Layout_compute(l))
+        return NULL;
+
+    uint xPos, yPos, xSize, ySize;
+    Layout_frame(&l->nodes[slot].rect, &xPos, &yPos, &xSize, &ySize);
+    TermWindow *w = Window_createWindow(xPos, yPos, xSize, ySize, name, borderCol);
+    if (w != NULL)
+        l->nodes[slot].w = w;
+    return w;
+}
+
+/// @brief Creates a task with a window filling a slot of a layout
+/// @param taskFunc Function which the task will use
+/// @param l Layout
+/// @param slot Slot to place the window in
+/// @param name Name of the task and window
+/// @param borderCol Border colour of the window
+void Window_createTaskWithLayout(TaskFunction_t taskFunc, WindowLayout *l, int slot, char name[], uint8_t borderCol)
+{
+    TermWindow *w = Window_createLayoutWindow(l, slot, name, borderCol);
+    if (w != NULL)
+        Window_startTask(w, taskFunc, name, WINDOW_TASK_STACK);
+}
+
+/// @brief Changes the share of its parent's space a node gets. Takes effect with Window_applyLayout.
+/// @param l Layout
+/// @param node Node
+/// @param weight Share of the parent's space, from 1 to 255
+void Window_setLayoutWeight(WindowLayout *l, int node, uint weight)
+{
+    if (node > LAYOUT_ROOT && node < l->nrNodes)
+        l->nodes[node].weight = Layout_weight(weight);
+}
+
+/// @brief Places an existing window in a slot, or empties the slot. Takes effect with Window_applyLayout.
+/// @param l Layout
+/// @param slot Slot
+/// @param w Window, or NULL
+void Window_setLayoutWindow(WindowLayout *l, int slot, TermWindow *w)
+{
+    if (slot >= 0 && slot < l->nrNodes && l->nodes[slot].type == LAYOUT_SLOT)
+        l->nodes[slot].w = w;
+}
+
+static inline bool Layout_overlap(WindowRect *a, WindowRect *b)
+{
+    return a->x < b->x + b->width && b->x < a->x + a->width && a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+/// @brief Moves a window's content to its new place, keeping what fits of it. Content areas start on whole framebuffer bytes,
+/// so each row is a single block copy. The rest of the new area is filled with the background.
+static void Layout_moveContent(TermWindow *w, WindowRect *dst)
+{
+    uint keptWidth = (dst->width < w->xRes) ? dst->width : w->xRes;
+    uint keptHeight = (dst->height < w->yRes) ? dst->height : w->yRes;
+    uint keptBytes = FB_BYTES(keptWidth);
+    uint8_t fill = Pixel_fill(w->bgCol);
+
+    // Rows are copied in the order which does not overwrite rows still to be copied
+    bool down = dst->y > w->yPos;
+    for (int k = 0; k < keptHeight; k++)
+    {
+        int i = down ? keptHeight - 1 - k : k;
+        uint8_t *d = Pixel_pointer(dst->x, dst->y + i);
+        memmove(d, Pixel_pointer(w->xPos, w->yPos + i), keptBytes);
+        memset(d + keptBytes, fill, FB_BYTES(dst->width) - keptBytes);
+    }
+    for (int i = keptHeight; i < dst->height; i++)
+        memset(Pixel_pointer(dst->x, dst->y + i), fill, FB_BYTES(dst->width));
+}
+
+static inline bool Layout_sameCells(TermWindow *w, WindowRect *dst)
+{
+    return dst->height / FONT_HEIGHT - 1 == w->maxRows && dst->width / FONT_WIDTH == w->maxCols;
+}
+
+/// @brief Allocates the text buffer of a window for its new size, before anything is moved
+/// @return false if there is not enough memory. cells is NULL if the window keeps its buffer.
+static bool Layout_allocCells(TermWindow *w, WindowRect *dst, WindowCell **cells)
+{
+    *cells = NULL;
+    if (Layout_sameCells(w, dst))
+        return true;
+    *cells = pvPortMalloc((dst->height / FONT_HEIGHT - 1) * (dst->width / FONT_WIDTH) * sizeof(WindowCell));
+    return *cells != NULL;
+}
+
+/// @brief Changes the size of a window's text buffer, keeping the text which still fits
+/// @param cells Buffer for the new size, from Layout_allocCells
+static void Layout_resizeCells(TermWindow *w, uint xSize, uint ySize, WindowCell *cells)
+{
+    uint maxRows = ySize / FONT_HEIGHT - 1;
+    uint maxCols = xSize / FONT_WIDTH;
+    if (cells == NULL)
+        return;
+
+    WindowCell blank = {' ', WINDOW_ATTR(w->textCol, w->bgCol)};
+    for (int row = 0; row < maxRows; row++)
+        for (int col = 0; col < maxCols; col++)
+            cells[row * maxCols + col] = (row < w->maxRows && col < w->maxCols) ? w->cells[row * w->maxCols + col] : blank;
+
+    vPortFree(w->cells);
+    w->cells = cells;
+    w->cellsCapacity = maxRows * maxCols;
+    w->maxRows = maxRows;
+    w->maxCols = maxCols;
+}
+
+/// @brief Gives a window its new place and size
+static void Layout_setGeometry(TermWindow *w, WindowRect *dst, WindowCell *cells)
+{
+    Layout_resizeCells(w, dst->width, dst->height, cells);
+    w->xPos = dst->x;
+    w->yPos = dst->y;
+    w->xRes = dst->width;
+    w->yRes = dst->height;
+    w->damage.width = 0;
+    Window_setTextSize(w, w->textSize);
+    if (w->currentRow >= w->term_rows)
+        w->currentRow = w->term_rows - 1;
+    if (w->currentCol >= w->term_cols)
+        w->currentCol = w->term_cols - 1;
+}
+
+/// @brief Places the windows of a layout in their slots, after weights or slots have been changed.
+/// Window contents (text and drawings) are moved with block copies instead of being redrawn. Windows swapping places
+/// cannot both be copied, and one of them is redrawn from its text. Empty slots are cleared.
+/// The windows' tasks should not be writing to them meanwhile, and no dialog may be open.
+/// @param l Layout
+/// @return false if a slot is too small to hold a window or there is not enough memory for the resized text buffers,
+/// in which case nothing is changed
+bool Window_applyLayout(WindowLayout *l)
+{
+    if (modalWindow != NULL || !Layout_compute(l))
+        return false;
+
+    takeWindowsSemaphore();
+
+    // Content areas, where each window is now and where it goes
+    WindowRect src[MAX_LAYOUT_NODES], dst[MAX_LAYOUT_NODES];
+    WindowCell *cells[MAX_LAYOUT_NODES];
+    bool pending[MAX_LAYOUT_NODES];
+    bool allocated = true;
+    for (int i = 0; i < l->nrNodes; i++)
+    {
+        TermWindow *w = l->nodes[i].w;
+        cells[i] = NULL;
+        pending[i] = l->nodes[i].type == LAYOUT_SLOT && w != NULL;
+        if (!pending[i])
+            continue;
+
+        uint xPos, yPos, xSize, ySize;
+        Layout_frame(&l->nodes[i].rect, &xPos, &yPos, &xSize, &ySize);
+        src[i] = (WindowRect){w->xPos, w->yPos, w->xRes, w->yRes};
+        dst[i] = (WindowRect){xPos + 2, yPos + 2, xSize, ySize};
+        allocated = allocated && Layout_allocCells(w, &dst[i], &cells[i]);
+    }
+
+    // Every text buffer is there before any window moves, so that running out of memory changes nothing
+    if (!allocated)
+    {
+        for (int i = 0; i < l->nrNodes; i++)
+            vPortFree(cells[i]);
+        giveWindowsSemaphore();
+        return false;
+    }
+    for (int i = 0; i < l->nrNodes; i++)
+        if (pending[i])
+            Window_clearHighlight(l->nodes[i].w);
+
+    // Move a window once its new area no longer covers content still to be moved, until none can be
+    bool moved = true;
+    while (moved)
+    {
+        moved = false;
+        for (int i = 0; i < l->nrNodes; i++)
+        {
+            if (!pending[i])
+                continue;
+            bool blocked = false;
+            for (int j = 0; j < l->nrNodes && !blocked; j++)
+                blocked = j != i && pending[j] && Layout_overlap(&dst[i], &src[j]);
+            if (blocked)
+                continue;
+
+            Layout_moveContent(l->nodes[i].w, &dst[i]);
+            Layout_setGeometry(l->nodes[i].w, &dst[i], cells[i]);
+            pending[i] = false;
+            moved = true;
+        }
+    }
+
+    // What is left moves in a cycle, so it is redrawn from the cells
+    for (int i = 0; i < l->nrNodes; i++)
+        if (pending[i])
+        {
+            TermWindow *w = l->nodes[i].w;
+            Layout_setGeometry(w, &dst[i], cells[i]);
+            Window_beginUpdate(w);
+            w->updateClear = true;
+            Window_endUpdate(w);
+        }
+
+    // Frames are drawn last, as content copies may have crossed them
+    for (int i = 0; i < l->nrNodes; i++)
+    {
+        WindowLayoutNode *n = &l->nodes[i];
+        if (n->type != LAYOUT_SLOT)
+            continue;
+        if (n->w != NULL)
+            Window_drawFrame(n->w);
+        else
+            GFX_fillRect(n->rect.x, n->rect.y, n->rect.width, n->rect.height, BLACK);
+    }
+
+    Window_markScreenDamage(l->area.x, l->area.y, l->area.width, l->area.height);
+    windowsGeneration++;
+    giveWindowsSemaphore();
+    return true;
+}
@@ -0,0 +1,375 @@
+#include "pico/stdlib.h"
+#include "stdarg.h"
+#include "stdio.h"
+#include "string.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "window.h"
+#include "window_rtos.h"
+
+// Each line record is a state byte, a length byte and the text. Records never wrap around the end of the ring:
+// if one doesn't fit, the rest of the ring is skipped (marked with LOG_PAD when there's room for a header).
+#define LOG_BUSY 0x00  // reserved, the producer is still copying the text
+#define LOG_READY 0x01 // complete, can be drawn
+#define LOG_PAD 0x02   // skip to the beginning of the ring
+#define LOG_HEADER_LEN 2
+
+// Records never wrap, so a ring of twice the longest record is the least which always has room for a line once it is empty
+#define LOG_MIN_SIZE (2 * (LOG_HEADER_LEN + LOG_LINE_LEN))
+
+/// @brief Sets up a window for being written by multiple tasks at once, through Window_logLine.
+/// Lines are queued in a ring and drawn by the render task, so they never interleave.
+/// @param w Window
+/// @param size Size of the line ring in bytes, rounded up to a power of two of at least two full lines
+void Window_enableLog(TermWindow *w, uint size)
+{
+    if (size < LOG_MIN_SIZE)
+        size = LOG_MIN_SIZE;
+    uint ringSize = 1;
+    while (ringSize < size)
+        ringSize *= 2;
+
+    WindowLog *log = pvPortMalloc(sizeof(WindowLog));
+    log->buf = pvPortMalloc(ringSize);
+    log->size = ringSize;
+    log->head = 0;
+    log->tail = 0;
+    log->dropped = 0;
+    w->log = log;
+}
+
+/// @brief Frees the line and record logs of a window, which is being destroyed
+/// @param w Window
+void Window_freeLogs(TermWindow *w)
+{
+    if (w->log != NULL)
+    {
+        vPortFree(w->log->buf);
+        vPortFree(w->log);
+        w->log = NULL;
+    }
+    if (w->records != NULL)
+    {
+        vPortFree(w->records->recs);
+        vPortFree(w->records);
+        w->records = NULL;
+    }
+}
+
+/// @brief Reserves space for a record in the ring. Only the reservation happens with interrupts disabled,
+/// as the RP2040's Cortex-M0+ cores have no atomic read-modify-write instructions.
+/// @return Pointer to the record, or NULL if the ring is full
+static uint8_t *Log_reserve(WindowLog *log, uint len)
+{
+    uint8_t *rec = NULL;
+
+    taskENTER_CRITICAL();
+    uint32_t pos = log->head;
+    uint offset = pos & (log->size - 1);
+    uint skip = (log->size - offset < len) ? log->size - offset : 0;
+
+    if (pos + skip + len - log->tail <= log->size)
+    {
+        if (skip >= LOG_HEADER_LEN)
+            log->buf[offset] = LOG_PAD;
+        rec = log->buf + ((pos + skip) & (log->size - 1));
+        rec[0] = LOG_BUSY;
+        log->head = pos + skip + len;
+    }
+    else
+        log->dropped++;
+    taskEXIT_CRITICAL();
+
+    return rec;
+}
+
+/// @brief Prints a formatted line to a window which may be written by other tasks at the same time.
+/// The line is queued without waiting for it to be drawn, and appears whole, followed by a newline.
+/// If the ring is full, the line is dropped and counted. Requires Window_enableLog.
+/// @param w Window to write to
+/// @param format Format string
+/// @param
+void Window_logLine(TermWindow *w, const char *format, ...)
+{
+    char line[LOG_LINE_LEN];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (len < 0)
+        return;
+    if (len >= sizeof(line))
+        len = sizeof(line) - 1;
+
+    uint8_t *rec = Log_reserve(w->log, LOG_HEADER_LEN + len);
+    if (rec == NULL)
+        return;
+
+    rec[1] = len;
+    memcpy(rec + LOG_HEADER_LEN, line, len);
+    __sync_synchronize(); // the text has to be visible before the record is marked ready
+    rec[0] = LOG_READY;
+
+    Window_wakeRenderer();
+}
+
+/// @brief Draws all complete lines queued in a window's ring, in the order they were reserved.
+/// Stops at the first line still being written. Only called by the render task.
+/// @param w Window
+void Window_drainLog(TermWindow *w)
+{
+    WindowLog *log = w->log;
+
+    while (log->tail != log->head)
+    {
+        uint offset = log->tail & (log->size - 1);
+        uint8_t *rec = log->buf + offset;
+
+        if (log->size - offset < LOG_HEADER_LEN || rec[0] == LOG_PAD)
+        {
+            log->tail += log->size - offset;
+            continue;
+        }
+        if (rec[0] != LOG_READY)
+            break;
+
+        __sync_synchronize();
+        uint len = rec[1];
+        for (int i = 0; i < len; i++)
+            Window_write(w, rec[LOG_HEADER_LEN + i]);
+        Window_write(w, '\n');
+        log->tail += LOG_HEADER_LEN + len;
+    }
+}
+
+/// @brief Returns how many lines were dropped because a window's ring was full
+/// @param w Window
+/// @return number of dropped lines
+uint32_t Window_getLogDropped(TermWindow *w)
+{
+    return w->log->dropped;
+}
+
+/// @brief Sets up a window for deferred-formatting logging, through WINDOW_LOG_RECORD.
+/// Records hold the format string and raw arguments, and are only formatted when they are shown.
+/// @param w Window
+/// @param records Number of records kept, rounded up to a power of two. Older records can be scrolled back to.
+void Window_enableRecordLog(TermWindow *w, uint records)
+{
+    uint count = 16;
+    while (count < records)
+        count *= 2;
+
+    WindowRecordLog *log = pvPortMalloc(sizeof(WindowRecordLog));
+    log->recs = pvPortMalloc(count * sizeof(WindowRecord));
+    log->count = count;
+    log->head = 0;
+    log->drawn = 0;
+    log->viewOffset = 0;
+    log->redraw = false;
+    for (int i = 0; i < count; i++)
+        log->recs[i].seq = RECORD_BUSY;
+    w->records = log;
+}
+
+/// @brief Stores a log record in a window without formatting it. Use through the WINDOW_LOG_RECORD macro, which passes
+/// each argument as a uintptr_t. Formats can use integers up to the size of a pointer, characters, pointers, and strings
+/// which stay valid (such as literals).
+/// @param w Window to log to. Requires Window_enableRecordLog.
+/// @param format Format string, which must stay valid (a literal)
+/// @param nargs Number of arguments, at most RECORD_MAX_ARGS
+/// @param ... Arguments, as uintptr_t
+void Window_logRecord(TermWindow *w, const char *format, uint nargs, ...)
+{
+    WindowRecordLog *log = w->records;
+
+    taskENTER_CRITICAL();
+    uint32_t seq = log->head++;
+    WindowRecord *rec = &log->recs[seq & (log->count - 1)];
+    rec->seq = RECORD_BUSY;
+    taskEXIT_CRITICAL();
+
+    va_list args;
+    va_start(args, nargs);
+    rec->format = format;
+    for (int i = 0; i < nargs && i < RECORD_MAX_ARGS; i++)
+        rec->args[i] = va_arg(args, uintptr_t);
+    va_end(args);
+
+    __sync_synchronize(); // the record has to be complete before it is published
+    rec->seq = seq;
+
+    Window_wakeRenderer();
+}
+
+/// @brief Formats one conversion of a record, passing the stored word as the type the conversion takes
+/// @param spec Conversion, from the '%' to the conversion character
+/// @return Number of characters the conversion needs, as snprintf returns
+static int Record_convert(char *dst, size_t size, const char *spec, uintptr_t arg)
+{
+    char conv = spec[strlen(spec) - 1];
+    bool isLong = strchr(spec, 'l') != NULL, isLongLong = strstr(spec, "ll") != NULL;
+    bool isSize = strchr(spec, 'z') != NULL || strchr(spec, 't') != NULL || strchr(spec, 'j') != NULL;
+
+    switch (conv)
+    {
+    case 'd':
+    case 'i':
+        if (isLongLong || strchr(spec, 'j'))
+            return snprintf(dst, size, spec, (long long)(intptr_t)arg);
+        if (isLong || isSize)
+            return snprintf(dst, size, spec, (long)(intptr_t)arg);
+        return snprintf(dst, size, spec, (int)(intptr_t)arg);
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        if (isLongLong || strchr(spec, 'j'))
+            return snprintf(dst, size, spec, (unsigned long long)arg);
+        if (isLong || isSize)
+            return snprintf(dst, size, spec, (unsigned long)arg);
+        return snprintf(dst, size, spec, (unsigned)arg);
+    case 'c':
+        return snprintf(dst, size, spec, (int)arg);
+    case 's':
+        return snprintf(dst, size, spec, arg ? (const char *)arg : "(null)");
+    case 'p':
+        return snprintf(dst, size, spec, (void *)arg);
+    default:
+        return snprintf(dst, size, "%s", spec); // floating point and %n are not stored
+    }
+}
+
+/// @brief Formats a record. Each conversion of the format is formatted on its own, with its argument converted back to
+/// the type the conversion takes, as reading a stored word as another type would be undefined.
+static void Record_format(char *line, size_t size, const char *format, const uintptr_t *args)
+{
+    size_t len = 0;
+    int next = 0;
+    char spec[24];
+
+    for (const char *f = format; *f && len + 1 < size;)
+    {
+        if (*f != '%')
+        {
+            line[len++] = *f++;
+            continue;
+        }
+        if (f[1] == '%')
+        {
+            line[len++] = '%';
+            f += 2;
+            continue;
+        }
+
+        // flags, width, precision and length, up to the conversion character
+        int specLen = 0;
+        spec[specLen++] = *f++;
+        while (*f && !strchr("diouxXcspfFeEgGaAn", *f) && specLen < sizeof(spec) - 2)
+        {
+            if (*f == '*')
+            {
+                // a width or precision given as an argument is written into the conversion
+                int n = (next < RECORD_MAX_ARGS) ? (int)(intptr_t)args[next++] : 0;
+                specLen += snprintf(spec + specLen, sizeof(spec) - specLen, "%d", n);
+                if (specLen > sizeof(spec) - 2)
+                    specLen = sizeof(spec) - 2;
+                f++;
+            }
+            else
+                spec[specLen++] = *f++;
+        }
+        if (*f == 0)
+            break;
+        spec[specLen++] = *f++;
+        spec[specLen] = 0;
+
+        uintptr_t arg = (next < RECORD_MAX_ARGS) ? args[next++] : 0;
+        int n = Record_convert(line + len, size - len, spec, arg);
+        if (n > 0)
+            len += n;
+    }
+    if (len >= size)
+        len = size - 1;
+    line[len] = 0;
+}
+
+/// @brief Formats and draws the records [start, end) of a window's record log
+/// @return Sequence number of the first record which could not be drawn yet, because it is still being written
+static uint32_t Record_drawRange(TermWindow *w, WindowRecordLog *log, uint32_t start, uint32_t end)
+{
+    char line[LOG_LINE_LEN];
+
+    for (uint32_t seq = start; seq != end; seq++)
+    {
+        WindowRecord *slot = &log->recs[seq & (log->count - 1)];
+        if (slot->seq == RECORD_BUSY)
+            return seq;
+
+        WindowRecord rec = *slot;
+        __sync_synchronize();
+        if (rec.seq != seq || slot->seq != seq)
+            continue; // overwritten by a newer record
+
+        Record_format(line, sizeof(line), rec.format, rec.args);
+        for (int i = 0; line[i]; i++)
+            Window_write(w, line[i]);
+        Window_write(w, '\n');
+    }
+    return end;
+}
+
+/// @brief Draws the records of a window's record log which are visible. Records which would have
+/// scrolled out of view before being seen are never formatted. Only called by the render task.
+/// @param w Window
+void Window_drainRecordLog(TermWindow *w)
+{
+    WindowRecordLog *log = w->records;
+    uint32_t head = log->head;
+    uint32_t rows = w->term_rows;
+    uint32_t oldest = (head > log->count) ? head - log->count : 0;
+
+    if (log->redraw)
+    {
+        log->redraw = false;
+        Window_clear(w);
+        uint32_t end = head - log->viewOffset;
+        uint32_t start = (end - oldest > rows) ? end - rows : oldest;
+        Record_drawRange(w, log, start, end);
+        log->drawn = head;
+        return;
+    }
+
+    // while scrolled back, the view stays frozen
+    if (log->viewOffset)
+        return;
+
+    uint32_t start = log->drawn;
+    if (head - start > rows)
+        start = head - rows;
+    log->drawn = Record_drawRange(w, log, start, head);
+}
+
+/// @brief Scrolls the view of a window's record log back to older records, or forward again
+/// @param w Window
+/// @param records How many records to scroll back (positive) or forward (negative). The view stops following new records while scrolled back.
+void Window_scrollRecordLog(TermWindow *w, int records)
+{
+    WindowRecordLog *log = w->records;
+    uint32_t head = log->head;
+    uint32_t kept = (head > log->count) ? log->count : head;
+    uint32_t maxOffset = (kept > w->term_rows) ? kept - w->term_rows : 0;
+
+    int offset = (int)log->viewOffset + records;
+    if (offset < 0)
+        offset = 0;
+    if (offset > maxOffset)
+        offset = maxOffset;
+
+    log->viewOffset = offset;
+    log->redraw = true;
+    Window_wakeRenderer();
+}
@@ -0,0 +1,356 @@
+#include "pico/stdlib.h"
+#include "stdio.h"
+#include "string.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "window.h"
+#include "window_rtos.h"
+
+// Mirror stream opcodes. Every operation is one opcode byte followed by its arguments.
+#define MIRROR_SELECT 0x01 // id: following operations apply to window id, write position is reset to 0, 0
+#define MIRROR_SIZE 0x02   // rows, cols: window geometry changed, remote window is blanked with white on black spaces
+#define MIRROR_MOVE 0x03   // row, col: move the remote write position
+#define MIRROR_ATTR 0x04   // attr: colours and attributes of the following text, as in WindowCell
+#define MIRROR_TEXT 0x05   // len, chars[len]: write characters, advancing the write position
+#define MIRROR_REPEAT 0x06 // count, char: write the same character count times
+#define MIRROR_SCROLL 0x07 // lines: scroll the window contents up
+#define MIRROR_CURSOR 0x08 // row, col: cursor position of the window
+#define MIRROR_FOCUS 0x09  // id: window in focus
+#define MIRROR_SYNC 0x0A   // end of a frame, the remote view is consistent
+
+// Sent by the remote side to request a full redraw of all windows
+#define MIRROR_RESYNC 0x00
+
+#define MIRROR_PERIOD_MS 50
+#define MIRROR_BUF_LEN 256
+#define MIRROR_MIN_REPEAT 4 // shorter repeats are cheaper as plain text
+#define MIRROR_MAX_GAP 2    // unchanged cells which are resent instead of moving past them
+
+typedef struct MirrorState
+{
+    WindowCell *sent; // window contents as last sent to the remote side
+    uint rows, cols;
+    uint scrollCount;
+    uint cursorRow, cursorCol;
+
+} MirrorState;
+
+static MirrorState mirrorStates[MAX_WINDOWS];
+
+TaskHandle_t mirrorHandle = NULL;
+
+static uint8_t mirrorBuf[MIRROR_BUF_LEN];
+static uint mirrorBufLen = 0;
+static uint mirrorBytesPerFrame;
+static uint mirrorBudget;
+static uint32_t mirrorBytesSent = 0;
+
+// Remote side state
+static int mirrorWindow;
+static int mirrorAttr;
+static int mirrorFocus;
+static uint mirrorRow, mirrorCol;
+
+static void Mirror_flush()
+{
+    fwrite(mirrorBuf, 1, mirrorBufLen, stdout);
+    fflush(stdout);
+    mirrorBytesSent += mirrorBufLen;
+    mirrorBufLen = 0;
+}
+
+/// @brief Reserves space for an operation in the current frame
+/// @param n size of the operation in bytes
+/// @return false if the frame's byte budget is exhausted
+static bool Mirror_reserve(uint n)
+{
+    if (n > mirrorBudget)
+        return false;
+    if (mirrorBufLen + n > MIRROR_BUF_LEN)
+        Mirror_flush();
+    mirrorBudget -= n;
+    return true;
+}
+
+static void Mirror_put(uint8_t b)
+{
+    mirrorBuf[mirrorBufLen++] = b;
+}
+
+static bool Mirror_select(uint id)
+{
+    if (mirrorWindow == id)
+        return true;
+    if (!Mirror_reserve(2))
+        return false;
+    Mirror_put(MIRROR_SELECT);
+    Mirror_put(id);
+    mirrorWindow = id;
+    mirrorAttr = -1;
+    mirrorRow = mirrorCol = 0;
+    return true;
+}
+
+static bool Mirror_move(uint row, uint col)
+{
+    if (mirrorRow == row && mirrorCol == col)
+        return true;
+    if (!Mirror_reserve(3))
+        return false;
+    Mirror_put(MIRROR_MOVE);
+    Mirror_put(row);
+    Mirror_put(col);
+    mirrorRow = row;
+    mirrorCol = col;
+    return true;
+}
+
+static uint Mirror_repeatLength(WindowCell *cells, uint a, uint b)
+{
+    uint n = 1;
+    while (a + n < b && n < 255 && cells[a + n].c == cells[a].c && cells[a + n].attr == cells[a].attr)
+        n++;
+    return n;
+}
+
+/// @brief Sends cells [a, b) of a row, which must start at the remote write position
+/// @return false if the frame's byte budget ran out
+static bool Mirror_sendCells(WindowCell *cur, WindowCell *sent, uint a, uint b)
+{
+    while (a < b)
+    {
+        WindowCell cell = cur[a];
+        if (cell.attr != mirrorAttr)
+        {
+            if (!Mirror_reserve(2))
+                return false;
+            Mirror_put(MIRROR_ATTR);
+            Mirror_put(cell.attr);
+            mirrorAttr = cell.attr;
+        }
+
+        uint n = Mirror_repeatLength(cur, a, b);
+        if (n >= MIRROR_MIN_REPEAT)
+        {
+            if (!Mirror_reserve(3))
+                return false;
+            Mirror_put(MIRROR_REPEAT);
+            Mirror_put(n);
+            Mirror_put(cell.c);
+            for (int i = 0; i < n; i++)
+                sent[a + i] = cell;
+        }
+        else
+        {
+            // plain text until the colour changes or a long enough repeat starts
+            n = 1;
+            while (a + n < b && n < 255 && cur[a + n].attr == cell.attr && Mirror_repeatLength(cur, a + n, b) < MIRROR_MIN_REPEAT)
+                n++;
+            if (!Mirror_reserve(2 + n))
+                return false;
+            Mirror_put(MIRROR_TEXT);
+            Mirror_put(n);
+            for (int i = 0; i < n; i++)
+            {
+                sent[a + i] = (WindowCell){cur[a + i].c, cell.attr};
+                Mirror_put(sent[a + i].c);
+            }
+        }
+        a += n;
+        mirrorCol += n;
+    }
+    return true;
+}
+
+static bool Mirror_cellChanged(WindowCell *cur, WindowCell *sent, uint i)
+{
+    return cur[i].c != sent[i].c || cur[i].attr != sent[i].attr;
+}
+
+/// @brief Sends the differences between a window and its copy on the remote side
+/// @return false if the frame's byte budget ran out
+static bool Mirror_sendWindow(uint id)
+{
+    TermWindow *w = windowCarousel[id];
+    MirrorState *m = &mirrorStates[id];
+    uint rows = w->term_rows;
+    uint cols = w->term_cols;
+
+    // windows in the middle of an update are sent once it is finished
+    if (w->updateDepth || updateGroups)
+        return true;
+
+    if (m->sent == NULL)
+        m->sent = pvPortMalloc(w->maxRows * w->maxCols * sizeof(WindowCell));
+
+    if (m->rows != rows || m->cols != cols)
+    {
+        if (!Mirror_select(id) || !Mirror_reserve(3))
+            return false;
+        Mirror_put(MIRROR_SIZE);
+        Mirror_put(rows);
+        Mirror_put(cols);
+        m->rows = rows;
+        m->cols = cols;
+        m->scrollCount = w->scrollCount;
+        for (int i = 0; i < w->maxRows * w->maxCols; i++)
+            m->sent[i] = (WindowCell){' ', WINDOW_ATTR(WHITE, BLACK)};
+        mirrorRow = mirrorCol = 0;
+    }
+
+    uint scrolled = w->scrollCount - m->scrollCount;
+    if (scrolled)
+    {
+        if (scrolled > rows)
+            scrolled = rows;
+        if (!Mirror_select(id) || !Mirror_reserve(2))
+            return false;
+        Mirror_put(MIRROR_SCROLL);
+        Mirror_put(scrolled);
+        memmove(m->sent, m->sent + scrolled * w->maxCols, (rows - scrolled) * w->maxCols * sizeof(WindowCell));
+        for (int i = (rows - scrolled) * w->maxCols; i < rows * w->maxCols; i++)
+            m->sent[i] = (WindowCell){' ', WINDOW_ATTR(WHITE, BLACK)};
+        m->scrollCount = w->scrollCount;
+    }
+
+    for (int r = 0; r < rows; r++)
+    {
+        WindowCell *cur = w->cells + r * w->maxCols;
+        WindowCell *sent = m->sent + r * w->maxCols;
+        uint c = 0;
+        while (c < cols)
+        {
+            if (!Mirror_cellChanged(cur, sent, c))
+            {
+                c++;
+                continue;
+            }
+
+            // extend the run over short gaps of unchanged cells
+            uint end = c + 1;
+            for (uint i = end; i < cols && i - end <= MIRROR_MAX_GAP; i++)
+                if (Mirror_cellChanged(cur, sent, i))
+                    end = i + 1;
+
+            if (!Mirror_select(id) || !Mirror_move(r, c) || !Mirror_sendCells(cur, sent, c, end))
+                return false;
+            c = end;
+        }
+    }
+
+    if (m->cursorRow != w->currentRow || m->cursorCol != w->currentCol)
+    {
+        if (!Mirror_select(id) || !Mirror_reserve(3))
+            return false;
+        m->cursorRow = w->currentRow;
+        m->cursorCol = w->currentCol;
+        Mirror_put(MIRROR_CURSOR);
+        Mirror_put(m->cursorRow);
+        Mirror_put(m->cursorCol);
+    }
+
+    return true;
+}
+
+static void Mirror_resync()
+{
+    for (int i = 0; i < MAX_WINDOWS; i++)
+        mirrorStates[i].rows = mirrorStates[i].cols = 0;
+    mirrorWindow = -1;
+    mirrorAttr = -1;
+    mirrorFocus = -1;
+}
+
+/// @brief Routes keys received from the remote side into the window in focus
+static void Mirror_receiveKeys()
+{
+    int c;
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT)
+    {
+        if (c == MIRROR_RESYNC)
+            Mirror_resync();
+        else
+            Window_routeKey(c);
+    }
+}
+
+static uint mirrorGeneration;
+static uint mirrorNext; // window each frame starts with, so that windows left out when the budget runs out go first next time
+
+static void Mirror_sendFrame()
+{
+    // Destroyed windows shift the IDs of the following ones, and their places may be taken by windows of another size
+    if (mirrorGeneration != windowsGeneration)
+    {
+        for (int i = 0; i < MAX_WINDOWS; i++)
+        {
+            vPortFree(mirrorStates[i].sent);
+            mirrorStates[i].sent = NULL;
+        }
+        Mirror_resync();
+        mirrorGeneration = windowsGeneration;
+    }
+
+    mirrorBudget = mirrorBytesPerFrame;
+    uint32_t frameStart = mirrorBytesSent + mirrorBufLen;
+
+    bool done = true;
+    uint start = nrWindows ? mirrorNext % nrWindows : 0;
+    for (int i = 0; i < nrWindows && done; i++)
+    {
+        uint id = (start + i) % nrWindows;
+        done = Mirror_sendWindow(id);
+        if (!done)
+            mirrorNext = id;
+    }
+
+    for (int i = 0; i < nrWindows && done; i++)
+        if (windowCarousel[i] == activeWindow && mirrorFocus != i && Mirror_reserve(2))
+        {
+            Mirror_put(MIRROR_FOCUS);
+            Mirror_put(i);
+            mirrorFocus = i;
+        }
+
+    // The frame marker is always sent, the budget only limits window contents
+    if (mirrorBytesSent + mirrorBufLen != frameStart)
+    {
+        mirrorBudget++;
+        Mirror_reserve(1);
+        Mirror_put(MIRROR_SYNC);
+        Mirror_flush();
+    }
+}
+
+void mirrorTask(void *p)
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    while (true)
+    {
+        vTaskDelayUntil(&lastWake, MIRROR_PERIOD_MS / portTICK_PERIOD_MS);
+        Mirror_receiveKeys();
+        takeWindowsSemaphore();
+        Mirror_sendFrame();
+        giveWindowsSemaphore();
+    }
+}
+
+/// @brief Starts mirroring all windows to stdio (UART or USB-CDC, as configured for the project).
+/// Only the differences since the last frame are sent, at most bytesPerSecond bytes per second. Keys received over stdio are sent to the window in focus.
+/// @param bytesPerSecond Bandwidth the mirror may use
+void Window_startMirror(uint bytesPerSecond)
+{
+    mirrorBytesPerFrame = bytesPerSecond * MIRROR_PERIOD_MS / 1000;
+    Mirror_resync();
+    mirrorGeneration = windowsGeneration;
+    xTaskCreate(mirrorTask, "Mirror", MIRROR_STACK, NULL, 1, &mirrorHandle);
+}
+
+/// @brief Returns the total number of bytes sent by the mirror, for measuring its bandwidth use
+/// @return number of bytes sent
+uint32_t Window_getMirrorBytesSent()
+{
+    return mirrorBytesSent;
+}
@@ -3,50 +3,263 @@
 #include "stdio.h"
 #include "string.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+
 #include "vga.h"
 #include "gfx.h"
 
 #include "window.h"
+#include "window_rtos.h"
+#include "window_pixel.h"
 
-/// @brief Sets the text size of specified window
-/// @param w Window of which text size to set
-/// @param s Text size
-void Window_setTextSize(TermWindow *w, uint s)
+volatile uint updateGroups = 0; // open updates spanning several windows
+
+// Keeps the cursor inside the window's text area, which shrinks when the text size grows
+static void Output_clampCursor(TermWindow *w)
 {
-    w->textSize = s;
-    w->term_rows = w->yRes / (8 * w->textSize) - 1;
-    w->term_cols = w->xRes / (6 * w->textSize);
-    GFX_setTextSize(s);
+    if (w->currentCol >= w->term_cols)
+        w->currentCol = w->term_cols ? w->term_cols - 1 : 0;
+    if (w->currentRow >= w->term_rows)
+        w->currentRow = w->term_rows ? w->term_rows - 1 : 0;
 }
 
-/// @brief Places the cursor of a window to specified location
+/// @brief Places the cursor of a window to specified location. Places outside the window are moved to its nearest edge.
 /// @param w Window of which cursor to move
 /// @param col Collumn to move cursor to
 /// @param row Row to move cursor to
 void Window_setCursor(TermWindow *w, int col, int row)
 {
-    w->currentCol = col;
-    w->currentRow = row;
-    GFX_setCursor(w->xPos + 6 * w->textSize * col, w->yPos + 8 * w->textSize * row + 1);
+    w->currentCol = (col > 0) ? col : 0;
+    w->currentRow = (row > 0) ? row : 0;
+    Output_clampCursor(w);
+    WINDOW_TRACE(TRACE_CURSOR, w, w->currentCol + 256 * w->currentRow);
 }
 
 void Window_CopyPixelLine(TermWindow *w, uint dst, uint src)
 {
-    extern unsigned char vga_data_array[TXCOUNT];
-
-    uint8_t *realSrc = vga_data_array + (320 * (src + w->yPos)) + (w->xPos / 2);
-    uint8_t *realDst = vga_data_array + (320 * (dst + w->yPos)) + (w->xPos / 2);
-    uint transferSize = w->xRes / 2;
-    dma_memcpy(realDst, realSrc, transferSize);
+    uint8_t *realSrc = Pixel_pointer(w->xPos, src + w->yPos);
+    uint8_t *realDst = Pixel_pointer(w->xPos, dst + w->yPos);
+    uint transferSize = FB_BYTES(w->xRes);
+    Window_dmaCopy(realDst, realSrc, transferSize);
 }
 
 void Window_DrawLineColor(TermWindow *w, uint line, uint8_t color)
 {
-    extern unsigned char vga_data_array[TXCOUNT];
+    uint8_t *realDst = Pixel_pointer(w->xPos, line + w->yPos);
+    uint transferSize = FB_BYTES(w->xRes);
+    Window_dmaFill(realDst, Pixel_fill(color), transferSize);
+}
+
+/// @brief Starts drawing text into a window, or changing what its update holds. A dialog opening holds the window's output back
+/// with an update and waits for drawing already under way. Other tasks drawing the same window's text wait their turn, so that
+/// what one marks as pending is not lost while another draws the update.
+static void Output_begin(TermWindow *w)
+{
+    Window_beginDraw(w);
+    while (__sync_lock_test_and_set(&w->outputBusy, true))
+        Window_taskYield();
+}
+
+static void Output_end(TermWindow *w)
+{
+    __sync_lock_release(&w->outputBusy);
+    Window_endDraw(w);
+}
+
+/// @brief Draws the cells changed so far during an update of a window, or everything after it was cleared
+static void Output_drawUpdate(TermWindow *w)
+{
+    if (w->updateClear)
+    {
+        for (int i = 0; i < w->yRes; i++)
+            Window_DrawLineColor(w, i, w->bgCol);
+        Window_markDamage(w, 0, 0, w->xRes, w->yRes);
+        w->dirtyRows = 0;
+        for (int row = 0; row < w->term_rows && row < 64; row++)
+        {
+            w->dirtyRows |= 1ull << row;
+            w->dirtyFrom[row] = 0;
+            w->dirtyTo[row] = w->term_cols - 1;
+        }
+    }
+
+    for (int row = 0; row < w->term_rows && row < 64; row++)
+        if (w->dirtyRows & (1ull << row))
+        {
+            WindowCell *cell = w->cells + row * w->maxCols;
+            for (int col = w->dirtyFrom[row]; col <= w->dirtyTo[row] && col < w->term_cols; col++)
+                Window_drawGlyph(w, col, row, cell[col].c, cell[col].attr);
+        }
+
+    w->dirtyRows = 0;
+    w->updateClear = false;
+    if (w->highlightPending)
+        Window_drawHighlights(w);
+}
+
+/// @brief Sets the text size of specified window. The size stays as it was if there is not enough memory for the scaled glyphs.
+/// @param w Window of which text size to set
+/// @param s Text size
+void Window_setTextSize(TermWindow *w, uint s)
+{
+    if (s > MAX_TEXT_SIZE)
+        s = MAX_TEXT_SIZE;
+    if (!Window_prepareGlyphSize(s))
+        return;
+    WINDOW_TRACE(TRACE_SIZE, w, s);
+    // what was written at the old size is drawn at it, unless a dialog covers the window: then all of it is redrawn at the new size when the dialog closes
+    Output_begin(w);
+    if (w->updateDepth && s != w->textSize)
+    {
+        if (w->hidden.width)
+            w->updateClear = true;
+        else
+            Output_drawUpdate(w);
+    }
+    Output_end(w);
+    w->textSize = s;
+    w->term_rows = w->yRes / (FONT_HEIGHT * w->textSize) - 1;
+    w->term_cols = w->xRes / (FONT_WIDTH * w->textSize);
+    Output_clampCursor(w);
+}
+
+/// @brief Adds a rectangle to the damaged area of a window
+/// @param w Window
+/// @param x X coordinate of the rectangle, relative to the window
+/// @param y Y coordinate of the rectangle, relative to the window
+/// @param width Width of the rectangle
+/// @param height Height of the rectangle
+void Window_markDamage(TermWindow *w, int x, int y, int width, int height)
+{
+    WindowRect *d = &w->damage;
+
+    enterCritical();
+    if (d->width == 0)
+        *d = (WindowRect){x, y, width, height};
+    else
+    {
+        int x1 = (x + width > d->x + d->width) ? x + width : d->x + d->width;
+        int y1 = (y + height > d->y + d->height) ? y + height : d->y + d->height;
+        if (x < d->x)
+            d->x = x;
+        if (y < d->y)
+            d->y = y;
+        d->width = x1 - d->x;
+        d->height = y1 - d->y;
+    }
+    exitCritical();
+}
+
+/// @brief Gets and resets the damaged area of a window, which covers everything drawn into it since the last call
+/// @param w Window
+/// @param r Where to store the damaged area, relative to the window
+/// @return false if nothing was drawn
+bool Window_takeDamage(TermWindow *w, WindowRect *r)
+{
+    enterCritical();
+    *r = w->damage;
+    w->damage.width = 0;
+    exitCritical();
+    return r->width != 0;
+}
+
+/// @brief Blanks the stored text content of some rows of a window
+/// @param w Window
+/// @param firstRow First row to blank
+/// @param rowsNum Number of rows to blank
+void Window_clearCells(TermWindow *w, uint firstRow, uint rowsNum)
+{
+    WindowCell *cell = w->cells + firstRow * w->maxCols;
+    for (int i = 0; i < rowsNum * w->maxCols; i++)
+        cell[i] = (WindowCell){' ', WINDOW_ATTR(w->textCol, w->bgCol)};
+}
+
+static inline void Output_markRows(TermWindow *w, uint firstRow, uint rowsNum)
+{
+    for (int i = firstRow; i < firstRow + rowsNum && i < 64; i++)
+    {
+        w->dirtyRows |= 1ull << i;
+        w->dirtyFrom[i] = 0;
+        w->dirtyTo[i] = w->maxCols - 1;
+    }
+}
+
+// Widens the dirty columns of a row to include a cell
+static inline void Output_markCell(TermWindow *w, uint col, uint row)
+{
+    if (row >= 64)
+        return;
+    if (!(w->dirtyRows & (1ull << row)))
+    {
+        w->dirtyRows |= 1ull << row;
+        w->dirtyFrom[row] = col;
+        w->dirtyTo[row] = col;
+    }
+    else if (col < w->dirtyFrom[row])
+        w->dirtyFrom[row] = col;
+    else if (col > w->dirtyTo[row])
+        w->dirtyTo[row] = col;
+}
+
+/// @brief Stores a character into a cell and draws it, or leaves drawing to the end of the update the window is in
+static inline void Output_cell(TermWindow *w, uint col, uint row, unsigned char c, uint8_t attr)
+{
+    WindowCell *cell = &w->cells[row * w->maxCols + col];
+    Output_begin(w);
+    if (w->updateDepth)
+    {
+        // cells which are not pending hold what is on screen, and need no redraw if they stay the same
+        if (cell->c != c || cell->attr != attr)
+            Output_markCell(w, col, row);
+        *cell = (WindowCell){c, attr};
+    }
+    else
+    {
+        *cell = (WindowCell){c, attr};
+        Window_drawGlyph(w, col, row, c, attr);
+    }
+    Output_end(w);
+}
 
-    uint8_t *realDst = vga_data_array + (320 * (line + w->yPos)) + (w->xPos / 2);
-    uint transferSize = w->xRes / 2;
-    dma_memset(realDst, color, transferSize);
+/// @brief Draws the character of a cell with other attributes than it holds (such as a highlight), without storing them
+/// @return false if the window is in an update: the cell is then redrawn as it is stored when the update ends
+bool Window_drawCell(TermWindow *w, uint col, uint row, uint8_t attr)
+{
+    Output_begin(w);
+    bool direct = !w->updateDepth;
+    if (direct)
+        Window_drawGlyph(w, col, row, w->cells[row * w->maxCols + col].c, attr);
+    else
+        Output_markCell(w, col, row);
+    Output_end(w);
+    return direct;
+}
+
+static void Output_scroll(TermWindow *w, int linesNum)
+{
+    Output_begin(w);
+    if (w->updateDepth)
+        Output_markRows(w, 0, w->term_rows); // the rows are redrawn from the cells when the update ends
+    else
+    {
+        uint startingLine = FONT_HEIGHT * w->textSize * linesNum;   // How many pixel lines we wanna shift up
+        uint totalLines = w->term_rows * FONT_HEIGHT * w->textSize; // w->yRes;
+        uint endingLine = totalLines - startingLine;
+
+        for (int i = 0; i < endingLine; i++)
+            Window_CopyPixelLine(w, i, startingLine + i);
+
+        for (int i = endingLine; i <= totalLines; i++)
+            Window_DrawLineColor(w, i, w->bgCol);
+        Window_markDamage(w, 0, 0, w->xRes, totalLines + 1);
+    }
+
+    uint keptRows = (linesNum < w->term_rows) ? w->term_rows - linesNum : 0;
+    memmove(w->cells, w->cells + (w->term_rows - keptRows) * w->maxCols, keptRows * w->maxCols * sizeof(WindowCell));
+    Window_clearCells(w, keptRows, w->term_rows - keptRows);
+    Output_end(w);
+    w->scrollCount += linesNum;
 }
 
 /// @brief Scroll down a number of text lines
@@ -54,23 +267,29 @@ void Window_DrawLineColor(TermWindow *w, uint line, uint8_t color)
 /// @param linesNum How many text lines to scroll
 void Window_scrollLines(TermWindow *w, int linesNum)
 {
-    uint startingLine = 8 * w->textSize * linesNum;   // How many pixel lines we wanna shift up
-    uint totalLines = w->term_rows * 8 * w->textSize; // w->yRes;
-    uint endingLine = totalLines - startingLine;
-
-    for (int i = 0; i < endingLine; i++)
-        Window_CopyPixelLine(w, i, startingLine + i);
-
-    for (int i = endingLine; i <= totalLines; i++)
-        Window_DrawLineColor(w, i, BLACK);
+    WINDOW_TRACE(TRACE_SCROLL, w, linesNum);
+    Output_scroll(w, linesNum);
 }
 
 /// @brief Clears a window and places the cursor at the beginning
 /// @param w Window to clear
 void Window_clear(TermWindow *w)
 {
-    for (int i = 0; i < w->yRes; i++)
-        Window_DrawLineColor(w, i, BLACK);
+    WINDOW_TRACE(TRACE_CLEAR, w, 0);
+    Output_begin(w);
+    if (w->updateDepth)
+    {
+        w->updateClear = true;
+        w->dirtyRows = 0;
+    }
+    else
+    {
+        for (int i = 0; i < w->yRes; i++)
+            Window_DrawLineColor(w, i, w->bgCol);
+        Window_markDamage(w, 0, 0, w->xRes, w->yRes);
+    }
+    Window_clearCells(w, 0, w->maxRows);
+    Output_end(w);
 
     w->currentCol = 0;
     w->currentRow = 0;
@@ -78,13 +297,77 @@ void Window_clear(TermWindow *w)
     Window_setTextSize(w, 1);
 }
 
+/// @brief Draws a character into a cell of a window, without moving the cursor
+/// @param w Window
+/// @param col Text column of the cell
+/// @param row Text row of the cell
+/// @param c Character to draw
+/// @param attr Cell attributes
+void Window_putCell(TermWindow *w, uint col, uint row, unsigned char c, uint8_t attr)
+{
+    WINDOW_TRACE(TRACE_CELL, w, c | (attr << 8) | (col << 16) | (row << 24));
+    Output_cell(w, col, row, c, attr);
+}
+
+/// @brief Starts an update of a window. Until the matching Window_endUpdate, text output only changes the window's
+/// stored content, and the rows which changed are then drawn at once. Updates can be nested.
+/// @param w Window
+void Window_beginUpdate(TermWindow *w)
+{
+    WINDOW_TRACE(TRACE_BEGIN, w, 0);
+    // other tasks hold back the output of windows under a dialog
+    enterCritical();
+    w->updateDepth++;
+    exitCritical();
+}
+
+/// @brief Ends an update of a window. When the outermost update ends, the cells changed during it are redrawn,
+/// from the first to the last changed one of each row.
+/// @param w Window
+void Window_endUpdate(TermWindow *w)
+{
+    WINDOW_TRACE(TRACE_END, w, 0);
+    Output_begin(w);
+    enterCritical();
+    bool outermost = w->updateDepth && --w->updateDepth == 0;
+    exitCritical();
+    if (outermost)
+        Output_drawUpdate(w);
+    Output_end(w);
+}
+
+/// @brief Starts an update spanning several windows. Nothing drawn in them is shown until Window_endUpdates.
+/// @param ws Windows
+/// @param n Number of windows
+void Window_beginUpdates(TermWindow *ws[], uint n)
+{
+    enterCritical();
+    updateGroups++;
+    exitCritical();
+    for (int i = 0; i < n; i++)
+        Window_beginUpdate(ws[i]);
+}
+
+/// @brief Ends an update spanning several windows, and draws what changed in all of them
+/// @param ws Windows
+/// @param n Number of windows
+void Window_endUpdates(TermWindow *ws[], uint n)
+{
+    for (int i = 0; i < n; i++)
+        Window_endUpdate(ws[i]);
+    enterCritical();
+    updateGroups--;
+    exitCritical();
+}
+
 /// @brief Writes a single character to specified window at the current cursor position
 /// @param w Window to write to
 /// @param c Character to write
 void Window_write(TermWindow *w, unsigned char c)
 {
-    GFX_setTextColor(w->textCol);
-    Window_setCursor(w, w->currentCol, w->currentRow);
+    uint8_t attr = WINDOW_ATTR(w->textCol, w->bgCol) | w->textAttr;
+    WINDOW_TRACE(TRACE_WRITE, w, c);
+
     if (c == '\n' || c == '\r')
     {
         w->currentRow++;
@@ -101,25 +384,25 @@ void Window_write(TermWindow *w, unsigned char c)
                 w->currentCol = w->term_cols - 1;
                 w->currentRow--;
             }
-            Window_setCursor(w, w->currentCol, w->currentRow);
-            GFX_write(' ');
+            Output_cell(w, w->currentCol, w->currentRow, ' ', attr);
         }
     }
     else
     {
-        GFX_write(c);
+        Output_cell(w, w->currentCol, w->currentRow, c, attr);
         w->currentCol++;
     }
 
-    if (w->currentCol == w->term_cols)
+    if (w->currentCol >= w->term_cols)
     {
         w->currentRow++;
         w->currentCol = 0;
     }
 
-    if (w->currentRow == w->term_rows)
+    if (w->currentRow >= w->term_rows)
     {
-        Window_scrollLines(w, 1);
+        // scrolling is part of the write, and replaying the write scrolls again
+        Output_scroll(w, 1);
         w->currentRow = w->term_rows - 1;
         w->currentCol = 0;
     }
@@ -153,6 +436,24 @@ void Window_printf(TermWindow *w, const char *format, ...)
 /// @param col Text colour
 void Window_setTextColour(TermWindow *w, uint8_t col)
 {
-    GFX_setTextColor(col);
     w->textCol = col;
+    WINDOW_TRACE(TRACE_ATTR, w, WINDOW_ATTR(w->textCol, w->bgCol) | w->textAttr);
+}
+
+/// @brief Sets the background colour of text to be written to specified window. Clearing and scrolling also fill with this colour.
+/// @param w Window
+/// @param col Background colour
+void Window_setBackgroundColour(TermWindow *w, uint8_t col)
+{
+    w->bgCol = col;
+    WINDOW_TRACE(TRACE_ATTR, w, WINDOW_ATTR(w->textCol, w->bgCol) | w->textAttr);
+}
+
+/// @brief Sets the attributes of text to be written to specified window
+/// @param w Window
+/// @param attr Combination of ATTR_INVERSE and ATTR_UNDERLINE, or 0 for plain text
+void Window_setTextAttributes(TermWindow *w, uint8_t attr)
+{
+    w->textAttr = attr & (ATTR_INVERSE | ATTR_UNDERLINE);
+    WINDOW_TRACE(TRACE_ATTR, w, WINDOW_ATTR(w->textCol, w->bgCol) | w->textAttr);
 }
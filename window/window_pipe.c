@@ -0,0 +1,208 @@
+#include "pico/stdlib.h"
+#include "string.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "window.h"
+#include "window_rtos.h"
+
+// Free-running byte counters: head - tail is the amount of data in the pipe, and the buffer position of a counter is its value modulo the size.
+// Only the producer moves head and only the consumer moves tail, so neither end needs a lock.
+
+static inline TickType_t Pipe_ticks(uint ms)
+{
+    return (ms == WINDOW_WAIT_FOREVER) ? portMAX_DELAY : ms / portTICK_PERIOD_MS;
+}
+
+/// @brief Blocks the calling task until a pipe end is ready or the timeout expires
+/// @param waiter where the other end looks for a task to wake
+/// @return what ready() returns last
+static uint Pipe_wait(WindowPipe *p, volatile TaskHandle_t *waiter, uint (*ready)(WindowPipe *p), uint ms)
+{
+    uint n = ready(p);
+    if (n || ms == 0)
+        return n;
+
+    TimeOut_t timeout;
+    TickType_t ticks = Pipe_ticks(ms);
+    vTaskSetTimeOutState(&timeout);
+    do
+    {
+        // registered before checking again, so that a wake up cannot be missed
+        *waiter = xTaskGetCurrentTaskHandle();
+        __sync_synchronize(); // the other end, maybe on the other core, must see the waiter before it is checked again
+        n = ready(p);
+        if (n == 0)
+            ulTaskNotifyTake(pdTRUE, ticks);
+        *waiter = NULL;
+        n = ready(p);
+    } while (n == 0 && xTaskCheckForTimeOut(&timeout, &ticks) == pdFALSE);
+
+    return n;
+}
+
+static inline void Pipe_wake(volatile TaskHandle_t *waiter)
+{
+    TaskHandle_t t = *waiter;
+    if (t != NULL)
+        xTaskNotifyGive(t);
+}
+
+// contiguous free space after head
+static uint Pipe_writable(WindowPipe *p)
+{
+    uint free = p->size - (p->head - p->tail);
+    uint toEnd = p->size - p->head % p->size;
+    return (free < toEnd) ? free : toEnd;
+}
+
+// contiguous data after tail
+static uint Pipe_readable(WindowPipe *p)
+{
+    uint used = p->head - p->tail;
+    uint toEnd = p->size - p->tail % p->size;
+    return (used < toEnd) ? used : toEnd;
+}
+
+/// @brief Creates a pipe, to pass a byte stream from one task to another
+/// @param size Size of the pipe's buffer in bytes, rounded up to a power of two
+/// @return Pointer to the created pipe, or NULL if there is not enough memory
+WindowPipe *Window_createPipe(uint size)
+{
+    // the counters wrap around at 2^32, where the buffer positions only stay continuous for powers of two
+    uint bufSize = 1;
+    while (bufSize < size)
+        bufSize *= 2;
+
+    WindowPipe *p = pvPortMalloc(sizeof(WindowPipe));
+    if (p == NULL)
+        return NULL;
+    p->buf = pvPortMalloc(bufSize);
+    if (p->buf == NULL)
+    {
+        vPortFree(p);
+        return NULL;
+    }
+    p->size = bufSize;
+    p->head = p->tail = 0;
+    p->reader = p->writer = NULL;
+    p->tee = NULL;
+    p->bytes = 0;
+    return p;
+}
+
+/// @brief Shows everything written into a pipe in a window as well, as text. The window should not be written to by anything else.
+/// @param p Pipe
+/// @param w Window to show the data in, or NULL to stop
+void Window_teePipe(WindowPipe *p, TermWindow *w)
+{
+    p->tee = w;
+}
+
+/// @brief Reserves space in a pipe for the producer to write into directly. Blocks until there is room.
+/// @param p Pipe
+/// @param len Number of bytes wanted. Receives the number of contiguous bytes reserved, which may be less (0 on timeout).
+/// @param ms Timeout in milliseconds, 0 to poll or WINDOW_WAIT_FOREVER to wait indefinitely
+/// @return Pointer to the reserved space
+uint8_t *Window_pipeReserve(WindowPipe *p, uint *len, uint ms)
+{
+    uint n = Pipe_wait(p, &p->writer, Pipe_writable, ms);
+    if (*len > n)
+        *len = n;
+    return p->buf + p->head % p->size;
+}
+
+/// @brief Makes data written into reserved space available to the consumer
+/// @param p Pipe
+/// @param len Number of bytes written, at most the number reserved
+void Window_pipeCommit(WindowPipe *p, uint len)
+{
+    if (p->tee != NULL)
+    {
+        uint8_t *data = p->buf + p->head % p->size;
+        for (int i = 0; i < len; i++)
+            Window_write(p->tee, data[i]);
+    }
+
+    __sync_synchronize(); // the data has to be visible before it is committed
+    p->head += len;
+    p->bytes += len;
+    __sync_synchronize();
+    Pipe_wake(&p->reader);
+}
+
+/// @brief Gives the consumer direct access to the data waiting in a pipe. Blocks until there is data.
+/// @param p Pipe
+/// @param len Receives the number of contiguous bytes available (0 on timeout)
+/// @param ms Timeout in milliseconds, 0 to poll or WINDOW_WAIT_FOREVER to wait indefinitely
+/// @return Pointer to the data
+const uint8_t *Window_pipePeek(WindowPipe *p, uint *len, uint ms)
+{
+    *len = Pipe_wait(p, &p->reader, Pipe_readable, ms);
+    return p->buf + p->tail % p->size;
+}
+
+/// @brief Frees data the consumer is done with
+/// @param p Pipe
+/// @param len Number of bytes consumed, at most the number peeked
+void Window_pipeRelease(WindowPipe *p, uint len)
+{
+    p->tail += len;
+    __sync_synchronize();
+    Pipe_wake(&p->writer);
+}
+
+/// @brief Copies data into a pipe, blocking while it is full
+/// @param p Pipe
+/// @param data Data to write
+/// @param len Number of bytes
+/// @param ms Timeout in milliseconds for each wait for room
+/// @return Number of bytes written
+uint Window_pipeWrite(WindowPipe *p, const void *data, uint len, uint ms)
+{
+    uint done = 0;
+    while (done < len)
+    {
+        uint n = len - done;
+        uint8_t *dst = Window_pipeReserve(p, &n, ms);
+        if (n == 0)
+            break;
+        memcpy(dst, (const uint8_t *)data + done, n);
+        Window_pipeCommit(p, n);
+        done += n;
+    }
+    return done;
+}
+
+/// @brief Copies data out of a pipe. Blocks until some data is available, then returns what there is.
+/// @param p Pipe
+/// @param buf Buffer to read into
+/// @param len Size of the buffer
+/// @param ms Timeout in milliseconds
+/// @return Number of bytes read
+uint Window_pipeRead(WindowPipe *p, void *buf, uint len, uint ms)
+{
+    uint done = 0;
+    while (done < len)
+    {
+        uint n;
+        const uint8_t *src = Window_pipePeek(p, &n, done ? 0 : ms);
+        if (n == 0)
+            break;
+        if (n > len - done)
+            n = len - done;
+        memcpy((uint8_t *)buf + done, src, n);
+        Window_pipeRelease(p, n);
+        done += n;
+    }
+    return done;
+}
+
+/// @brief Returns the number of bytes which went through a pipe, to measure its throughput
+/// @param p Pipe
+/// @return Number of bytes committed so far
+uint32_t Window_getPipeBytes(WindowPipe *p)
+{
+    return p->bytes;
+}
@@ -0,0 +1,70 @@
+#ifndef _WINDOW_PIXEL_H
+#define _WINDOW_PIXEL_H
+
+#include "pico/stdlib.h"
+#include "vga.h"
+
+#include "window_config.h"
+
+// Framebuffer access helpers. Each pixel format gets its own versions, so there is no branching on the format at runtime.
+
+extern unsigned char vga_data_array[TXCOUNT];
+
+_Static_assert(FB_STRIDE * FB_HEIGHT <= TXCOUNT, "framebuffer configuration does not fit the display driver");
+
+// Number of bytes covering a run of pixels which starts on a byte boundary
+#define FB_BYTES(pixels) (((pixels) + FB_PIXELS_PER_BYTE - 1) / FB_PIXELS_PER_BYTE)
+
+// Mask of the pixels in a byte, for indexing pattern tables
+#define FB_PIXEL_MASK ((1 << FB_PIXELS_PER_BYTE) - 1)
+
+static inline uint8_t *Pixel_row(uint y)
+{
+    return vga_data_array + FB_STRIDE * y;
+}
+
+static inline uint8_t *Pixel_pointer(uint x, uint y)
+{
+    return Pixel_row(y) + x / FB_PIXELS_PER_BYTE;
+}
+
+#if FB_BPP == 3
+
+static inline uint8_t Pixel_fill(uint8_t col)
+{
+    return col | (col << 3);
+}
+
+static inline uint8_t Pixel_get(const uint8_t *row, uint x)
+{
+    return (x % 2) ? (row[x / 2] >> 3) & 7 : row[x / 2] & 7;
+}
+
+static inline void Pixel_set(uint8_t *row, uint x, uint8_t col)
+{
+    if (x % 2)
+        row[x / 2] = (row[x / 2] & 0xC7) | (col << 3);
+    else
+        row[x / 2] = (row[x / 2] & 0xF8) | col;
+}
+
+#else
+
+static inline uint8_t Pixel_fill(uint8_t col)
+{
+    return col;
+}
+
+static inline uint8_t Pixel_get(const uint8_t *row, uint x)
+{
+    return row[x];
+}
+
+static inline void Pixel_set(uint8_t *row, uint x, uint8_t col)
+{
+    row[x] = col;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+#include "pico/stdlib.h"
+#include "malloc.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "window.h"
+#include "window_rtos.h"
+
+// Words kept free on top of the measured peak when suggesting a stack size
+#define PROFILE_STACK_MARGIN 64
+
+/// @brief Returns how much of the heap is used. The heap is malloc's (heap_3), which never gives memory back to the system,
+/// so the reserved size is also the peak of the heap over the run.
+/// @param used where to store the number of bytes currently allocated
+/// @param reserved where to store the number of bytes taken from the system by the heap
+void Window_getHeapStats(uint32_t *used, uint32_t *reserved)
+{
+    // glibc (the host build) deprecates mallinfo, whose int fields can overflow, for mallinfo2
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    *used = info.uordblks;
+    *reserved = info.arena;
+}
+
+static void Profile_printTask(TermWindow *w, TaskHandle_t task, uint stackWords)
+{
+    if (task == NULL)
+        return;
+
+    // The high water mark is the least free stack space the task ever had
+    uint free = uxTaskGetStackHighWaterMark(task);
+    if (stackWords)
+        Window_printf(w, "%-10.10s %5u %5u %5u\n", pcTaskGetName(task), stackWords, stackWords - free, stackWords - free + PROFILE_STACK_MARGIN);
+    else
+        Window_printf(w, "%-10.10s  min free %u\n", pcTaskGetName(task), free);
+}
+
+/// @brief Prints the peak stack use of every task and the heap use, measured since the start.
+/// Sizes are in words. The suggested size is the peak with some margin, for Window_createTaskWithWindowStack.
+/// @param w Window to print into
+void Window_printProfile(TermWindow *w)
+{
+    Window_printf(w, "Task        size  peak  sugg\n");
+    Profile_printTask(w, keyScanHandle, KEYSCAN_STACK);
+    Profile_printTask(w, renderHandle, RENDER_STACK);
+    Profile_printTask(w, mirrorHandle, MIRROR_STACK);
+
+    takeWindowsSemaphore();
+    for (int i = 0; i < nrWindows; i++)
+        Profile_printTask(w, windowCarousel[i]->task, windowCarousel[i]->stackWords);
+    giveWindowsSemaphore();
+
+    uint32_t used, reserved;
+    Window_getHeapStats(&used, &reserved);
+    Window_printf(w, "Heap: %u used, %u peak\n", (uint)used, (uint)reserved);
+}
+
+#if configCHECK_FOR_STACK_OVERFLOW
+void vApplicationStackOverflowHook(TaskHandle_t task, char *name)
+{
+    panic("Stack overflow in task %s", name);
+}
+#endif
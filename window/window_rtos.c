@@ -1,30 +1,108 @@
 
 #include "pico/stdlib.h"
+#include "hardware/sync.h"
 #include "window_rtos.h"
 #include "window.h"
 #include "ps2.h"
+#include "vga.h"
 
 #include "freertos.h"
 #include "task.h"
 #include "semphr.h"
 
-char kbBuf[50];
-uint kbKeys = 0;
-
 TaskHandle_t keyScanHandle;
+TaskHandle_t renderHandle = NULL;
 SemaphoreHandle_t keySemaphore;
+SemaphoreHandle_t windowsSemaphore = NULL;
+QueueHandle_t exitQueue; // windows of tasks which have exited, to be destroyed by the render task
 
-TaskHandle_t windowTaskList[MAX_WINDOWS];
-uint numCreatedTasks = 0;
+#if WINDOW_CORES > 1
+static spin_lock_t *dmaLock = NULL; // the display driver's DMA channel is shared by both cores
+#endif
 
 void giveKeySemaphore()
 {
-    xSemaphoreGive(keySemaphore);
+    if (keySemaphore != NULL)
+        xSemaphoreGive(keySemaphore);
 }
 
 void takeKeySemaphore()
 {
-    xSemaphoreTake(keySemaphore, portMAX_DELAY);
+    if (keySemaphore != NULL)
+        xSemaphoreTake(keySemaphore, portMAX_DELAY);
+}
+
+// Guards the list of windows against windows being destroyed while it is walked. Not needed before the scheduler starts.
+void giveWindowsSemaphore()
+{
+    if (windowsSemaphore != NULL)
+        xSemaphoreGive(windowsSemaphore);
+}
+
+void takeWindowsSemaphore()
+{
+    if (windowsSemaphore != NULL)
+        xSemaphoreTake(windowsSemaphore, portMAX_DELAY);
+}
+
+// Critical sections taken before the scheduler starts would leave interrupts disabled until it does,
+// which would stop the keyboard during initialization. Nothing can preempt the caller before then anyway.
+void enterCritical()
+{
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+        taskENTER_CRITICAL();
+}
+
+void exitCritical()
+{
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+        taskEXIT_CRITICAL();
+}
+
+/// @brief Copies memory with the display driver's DMA channel. With two cores, copies take turns on the channel.
+void Window_dmaCopy(void *dst, const void *src, uint len)
+{
+#if WINDOW_CORES > 1
+    if (dmaLock != NULL)
+    {
+        uint32_t irq = spin_lock_blocking(dmaLock);
+        dma_memcpy(dst, (void *)src, len);
+        spin_unlock(dmaLock, irq);
+        return;
+    }
+#endif
+    dma_memcpy(dst, (void *)src, len);
+}
+
+/// @brief Fills memory with the display driver's DMA channel. With two cores, fills take turns on the channel.
+void Window_dmaFill(void *dst, uint8_t value, uint len)
+{
+#if WINDOW_CORES > 1
+    if (dmaLock != NULL)
+    {
+        uint32_t irq = spin_lock_blocking(dmaLock);
+        dma_memset(dst, value, len);
+        spin_unlock(dmaLock, irq);
+        return;
+    }
+#endif
+    dma_memset(dst, value, len);
+}
+
+/// @brief Restricts the task of a window to some of the cores. Only has an effect with the SMP kernel (WINDOW_SMP builds).
+/// @param w Window whose task to restrict, created with its task
+/// @param coreMask Cores the task may run on: bit 0 for core 0, bit 1 for core 1
+/// @return false if the window has no task or the kernel runs on a single core
+bool Window_setCoreAffinity(TermWindow *w, uint coreMask)
+{
+#if WINDOW_CORES > 1
+    if (w->task == NULL)
+        return false;
+    vTaskCoreAffinitySet(w->task, coreMask);
+    return true;
+#else
+    return false;
+#endif
 }
 
 /// @brief Yields CPU time to other tasks
@@ -33,31 +111,135 @@ void Window_taskYield()
     taskYIELD();
 }
 
-void keyScan(void *p)
+// Keys which switch focus straight to a window
+static struct
+{
+    char key;
+    TermWindow *w;
+
+} focusKeys[MAX_FOCUS_KEYS];
+
+/// @brief Binds a key to switching focus to a window, or unbinds it. The key is not sent to any window.
+/// @param key Key to bind
+/// @param w Window to focus, or NULL to unbind the key
+/// @return false if MAX_FOCUS_KEYS keys are already bound
+bool Window_bindFocusKey(char key, TermWindow *w)
+{
+    bool bound = w == NULL;
+    takeKeySemaphore();
+    for (int i = 0; i < MAX_FOCUS_KEYS; i++)
+        if (focusKeys[i].w != NULL && focusKeys[i].key == key)
+            focusKeys[i].w = NULL;
+    for (int i = 0; i < MAX_FOCUS_KEYS && !bound; i++)
+        if (focusKeys[i].w == NULL)
+        {
+            focusKeys[i].key = key;
+            focusKeys[i].w = w;
+            bound = true;
+        }
+    giveKeySemaphore();
+    return bound;
+}
+
+/// @brief Unbinds the focus keys of a window which goes away. The key semaphore must be held.
+void Window_unbindFocusKeys(TermWindow *w)
+{
+    for (int i = 0; i < MAX_FOCUS_KEYS; i++)
+        if (focusKeys[i].w == w)
+            focusKeys[i].w = NULL;
+}
+
+/// @brief Sends a keypress to the window in focus, or handles it if it is bound to the window system. The key semaphore must be held.
+/// @param c Key to route
+/// @return What happened to the key
+KeyRoute Window_deliverKey(char c)
+{
+    if (c == PS2_SHIFT_TAB)
+    {
+        Window_nextWindow();
+        return KEY_HANDLED;
+    }
+    if (c == searchKey && searchKey && Window_requestSearch())
+        return KEY_HANDLED;
+    for (int i = 0; i < MAX_FOCUS_KEYS; i++)
+        if (focusKeys[i].w != NULL && focusKeys[i].key == c)
+        {
+            // dialogs keep the focus
+            if (modalWindow == NULL)
+                Window_setActiveWindow(focusKeys[i].w);
+            return KEY_HANDLED;
+        }
+
+    if (activeWindow == NULL)
+        return KEY_DROPPED;
+    if (xQueueSendToBack(activeWindow->keyQueue, &c, 0) != pdTRUE)
+        return KEY_FULL;
+    WINDOW_TRACE(TRACE_KEY, activeWindow, c);
+    return KEY_DELIVERED;
+}
+
+/// @brief Sends a keypress to the window in focus, or switches focus on Shift+Tab. Keys which do not fit into the window's queue are dropped.
+/// @param c Key to route
+void Window_routeKey(char c)
 {
-    char c;
+    takeKeySemaphore();
+    Window_deliverKey(c);
+    giveKeySemaphore();
+}
 
+void keyScan(void *p)
+{
     while (true)
     {
-        while (!PS2_keyAvailable())
+        if (!Window_pollInputSources())
             Window_taskYield();
-        takeKeySemaphore();
-        c = PS2_readKey();
-        switch (c)
-        {
-        case PS2_SHIFT_TAB:
-            Window_nextWindow();
-            break;
+    }
+}
+
+/// @brief Wakes up the render task, to draw output queued by other tasks
+void Window_wakeRenderer()
+{
+    if (renderHandle != NULL)
+        xTaskNotifyGive(renderHandle);
+}
+
+/// @brief Wakes up the render task ahead of the window tasks, for changes which should show up right away even when they are busy
+void Window_raiseRenderer()
+{
+    if (renderHandle == NULL)
+        return;
+    vTaskPrioritySet(renderHandle, RENDER_FOCUS_PRIORITY);
+    xTaskNotifyGive(renderHandle);
+}
 
-        default:
-            kbBuf[kbKeys++] = c;
-            break;
+void windowRender(void *p)
+{
+    while (true)
+    {
+        TermWindow *exited;
+        while (xQueueReceive(exitQueue, &exited, 0) == pdTRUE)
+            Window_release(exited, true);
+
+        takeWindowsSemaphore();
+        for (int i = 0; i < nrWindows; i++)
+        {
+            if (windowCarousel[i]->log != NULL)
+                Window_drainLog(windowCarousel[i]);
+            if (windowCarousel[i]->records != NULL)
+                Window_drainRecordLog(windowCarousel[i]);
         }
-        giveKeySemaphore();
+        Window_drawFocus();
+        Window_flushDisplay();
+        giveWindowsSemaphore();
+        vTaskPrioritySet(NULL, RENDER_PRIORITY);
+
+        // Displays which need flushing also get what the tasks draw directly, at a fixed frame rate
+        ulTaskNotifyTake(pdTRUE, Window_displayNeedsFlush() ? DISPLAY_FRAME_MS / portTICK_PERIOD_MS : portMAX_DELAY);
     }
 }
 
 /// @brief Creates a task and an associated window. The pointer to the created window gets transmitted to the task.
+/// The task gets a stack of WINDOW_TASK_STACK words.
 /// @param taskFunc Function which the task will use
 /// @param xPos X coordinate of the window on screen
 /// @param yPos Y coordinate of the window on screen
@@ -66,9 +248,67 @@ void keyScan(void *p)
 /// @param name Name of the task and window
 /// @param borderCol Border colour of the window
 void Window_createTaskWithWindow(TaskFunction_t taskFunc, uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol)
+{
+    Window_createTaskWithWindowStack(taskFunc, xPos, yPos, xSize, ySize, name, borderCol, WINDOW_TASK_STACK);
+}
+
+/// @brief Creates a task with a given stack size and an associated window, for using stack sizes measured with Window_printProfile.
+/// @param taskFunc Function which the task will use
+/// @param xPos X coordinate of the window on screen
+/// @param yPos Y coordinate of the window on screen
+/// @param xSize Horizontal size of the window
+/// @param ySize Vertical size of the window
+/// @param name Name of the task and window
+/// @param borderCol Border colour of the window
+/// @param stackWords Stack size of the task, in words
+void Window_createTaskWithWindowStack(TaskFunction_t taskFunc, uint xPos, uint yPos, uint xSize, uint ySize, char name[], uint8_t borderCol, uint stackWords)
 {
     TermWindow *w = Window_createWindow(xPos, yPos, xSize, ySize, name, borderCol);
-    xTaskCreate(taskFunc, name, 2048, w, 1, &windowTaskList[numCreatedTasks++]);
+    if (w != NULL)
+        Window_startTask(w, taskFunc, name, stackWords);
+}
+
+/// @brief Creates the task of a window, which gets the window as its parameter
+/// @param w Window of the task
+/// @param taskFunc Function which the task will use
+/// @param name Name of the task
+/// @param stackWords Stack size of the task, in words
+/// @return false if the task could not be created
+bool Window_startTask(TermWindow *w, TaskFunction_t taskFunc, char name[], uint stackWords)
+{
+    if (xTaskCreate(taskFunc, name, stackWords, w, 1, &w->task) != pdPASS)
+        return false;
+    w->stackWords = stackWords;
+    return true;
+}
+
+/// @brief Ends the calling task and destroys its window. Tasks should call this instead of returning from their function.
+/// @param w Window of the task
+void Window_exitTask(TermWindow *w)
+{
+    // A task deleting itself is only freed once the idle task runs, which the input task keeps from running.
+    // The render task deletes it instead, which frees it right away.
+    w->task = xTaskGetCurrentTaskHandle();
+    w->exiting = true;
+    xQueueSendToBack(exitQueue, &w, portMAX_DELAY);
+    Window_wakeRenderer();
+    vTaskSuspend(NULL);
+}
+
+/// @brief Tells whether another task has destroyed a window, which its task should answer by calling Window_exitTask.
+/// Tasks which wait for keys exit by themselves; this is for tasks which do not read input.
+/// @param w Window of the task
+/// @return true if the task should exit
+bool Window_exitRequested(TermWindow *w)
+{
+    return w->exitRequested;
+}
+
+/// @brief Ends the calling task through Window_exitTask if it is the window's task and the window has been destroyed
+void Window_checkExit(TermWindow *w)
+{
+    if (w->exitRequested && w->task == xTaskGetCurrentTaskHandle())
+        Window_exitTask(w);
 }
 
 /// @brief Blocks calling task for some amount of milliseconds
@@ -83,7 +323,14 @@ void Window_startRTOS()
 {
     keySemaphore = xSemaphoreCreateBinary();
     xSemaphoreGive(keySemaphore);
-    xTaskCreate(keyScan, "KeyScan", 128, NULL, 1, &keyScanHandle);
+    windowsSemaphore = xSemaphoreCreateBinary();
+    xSemaphoreGive(windowsSemaphore);
+    exitQueue = xQueueCreate(MAX_WINDOWS, sizeof(TermWindow *));
+#if WINDOW_CORES > 1
+    dmaLock = spin_lock_init(spin_lock_claim_unused(true));
+#endif
+    xTaskCreate(keyScan, "KeyScan", KEYSCAN_STACK, NULL, 1, &keyScanHandle);
+    xTaskCreate(windowRender, "Render", RENDER_STACK, NULL, RENDER_PRIORITY, &renderHandle);
 
     // Start FreeRTOS kernel
     vTaskStartScheduler();
@@ -3,11 +3,109 @@
 
 #include "pico/stdlib.h"
 
-extern char kbBuf[50];
-extern uint kbKeys;
+#include "window.h"
+
+#define KEYSCAN_STACK 256
+#define RENDER_STACK 512
+#define MIRROR_STACK 512
+
+// Cores the window tasks run on: 2 with the SMP kernel (WINDOW_SMP builds), otherwise 1
+#ifdef configNUMBER_OF_CORES
+#define WINDOW_CORES configNUMBER_OF_CORES
+#else
+#define WINDOW_CORES 1
+#endif
+
+// The render task runs alongside the window tasks, so that output queued to it is drawn in batches,
+// and is raised above them for focus changes
+#define RENDER_PRIORITY 1
+#define RENDER_FOCUS_PRIORITY 2
+
+extern TaskHandle_t keyScanHandle;
+extern TaskHandle_t renderHandle;
+extern TaskHandle_t mirrorHandle;
+
+extern TermWindow *windowCarousel[MAX_WINDOWS];
+extern uint nrWindows;
+extern TermWindow *modalWindow;
+extern volatile uint windowsGeneration;
 
 void giveKeySemaphore();
 void takeKeySemaphore();
+void giveWindowsSemaphore();
+void takeWindowsSemaphore();
+void enterCritical();
+void exitCritical();
+void Window_release(TermWindow *w, bool erase);
+bool Window_startTask(TermWindow *w, TaskFunction_t taskFunc, char name[], uint stackWords);
+typedef enum KeyRoute
+{
+    KEY_DELIVERED, // sent to the window in focus
+    KEY_HANDLED,   // used by the window system (focus switching, hotkeys)
+    KEY_DROPPED,   // no window in focus
+    KEY_FULL,      // the key queue of the window in focus is full
+
+} KeyRoute;
+
+KeyRoute Window_deliverKey(char c);
+void Window_routeKey(char c);
+extern char searchKey;
+bool Window_requestSearch();
+bool Window_pollInputSources();
+void Window_wakeRenderer();
+void Window_checkExit(TermWindow *w);
+bool Window_displayNeedsFlush();
+extern volatile uint updateGroups;
+
+void Window_drainLog(TermWindow *w);
+void Window_drainRecordLog(TermWindow *w);
+void Window_freeLogs(TermWindow *w);
+
+void Window_beginDraw(TermWindow *w);
+void Window_endDraw(TermWindow *w);
+
+void Window_clearCells(TermWindow *w, uint firstRow, uint rowsNum);
+void Window_putCell(TermWindow *w, uint col, uint row, unsigned char c, uint8_t attr);
+
+// Session trace events: the header byte holds the type in the high nibble and the window index in the low nibble,
+// followed by the microseconds since the previous event and an argument, both as varints
+#define TRACE_KEY 1    // key delivered to the window in focus
+#define TRACE_WRITE 2  // Window_write, argument is the character
+#define TRACE_CURSOR 3 // Window_setCursor, argument is col + 256 * row
+#define TRACE_SCROLL 4 // Window_scrollLines, argument is the number of lines
+#define TRACE_CLEAR 5  // Window_clear
+#define TRACE_SIZE 6   // Window_setTextSize, argument is the size
+#define TRACE_ATTR 7   // text colour, background or attributes changed, argument is the resulting attribute byte
+#define TRACE_FOCUS 8  // Window_setActiveWindow
+#define TRACE_TASK 9   // task switch, argument is the task's number in order of appearance
+#define TRACE_CELL 10  // Window_putCell, argument is c | attr << 8 | col << 16 | row << 24
+#define TRACE_BEGIN 11 // Window_beginUpdate
+#define TRACE_END 12   // Window_endUpdate
+#define TRACE_NO_WINDOW 0x0F
+
+extern volatile bool traceActive;
+void Window_traceEvent(uint8_t type, TermWindow *w, uint32_t arg);
+
+// Costs only a test of a flag while no trace is being recorded
+#define WINDOW_TRACE(type, w, arg)             \
+    do                                         \
+    {                                          \
+        if (traceActive)                       \
+            Window_traceEvent(type, w, arg);   \
+    } while (0)
+
+void Window_loadFont();
+bool Window_prepareGlyphSize(uint s);
+const uint8_t *Window_getGlyph(unsigned char c);
+void Window_drawFrame(TermWindow *w);
+void Window_drawFocus();
+void Window_raiseRenderer();
+void Window_dmaCopy(void *dst, const void *src, uint len);
+void Window_dmaFill(void *dst, uint8_t value, uint len);
+void Window_unbindFocusKeys(TermWindow *w);
+void Window_drawGlyph(TermWindow *w, uint col, uint row, unsigned char c, uint8_t attr);
+bool Window_drawCell(TermWindow *w, uint col, uint row, uint8_t attr);
+void Window_drawHighlights(TermWindow *w);
 
 
 
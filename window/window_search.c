@@ -0,0 +1,208 @@
+#include "pico/stdlib.h"
+#include "string.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "window.h"
+#include "window_rtos.h"
+
+#define SEARCH_STACK 512
+#define SEARCH_DIALOG_WIDTH 300
+#define SEARCH_DIALOG_HEIGHT 18
+
+char searchKey = 0;
+static TaskHandle_t searchHandle = NULL;
+static TermWindow *searchTarget;
+static volatile bool searchBusy = false;
+
+static uint32_t searchTime;
+
+/// @brief Finds the first cell holding a character. Cells are two bytes, so two of them are checked with each word read.
+/// @return Index of the cell, or n if there is none
+static uint Search_first(const WindowCell *cells, uint n, char c)
+{
+    uint i = 0;
+
+    // word reads have to be aligned
+    if (n && ((uintptr_t)cells & 2))
+    {
+        if (cells[0].c == c)
+            return 0;
+        i = 1;
+    }
+
+    // The characters sit in the low byte of each half of a word. XORing leaves a zero half where a character matches;
+    // subtracting 1 from each half then borrows into its top bit. Halves after a zero one can report false hits, which are checked.
+    uint32_t pattern = (uint8_t)c * 0x00010001u;
+    for (; i + 2 <= n; i += 2)
+    {
+        uint32_t word;
+        memcpy(&word, cells + i, sizeof(word)); // compiles to a single load, without reading cells through another type
+        uint32_t x = (word ^ pattern) & 0x00FF00FFu;
+        if ((x - 0x00010001u) & ~x & 0x80008000u)
+        {
+            if (cells[i].c == c)
+                return i;
+            if (cells[i + 1].c == c)
+                return i + 1;
+        }
+    }
+
+    if (i < n && cells[i].c == c)
+        return i;
+    return n;
+}
+
+/// @brief Finds a string in the text shown in a window. Matches are looked for within each row.
+/// @param w Window to search
+/// @param pattern String to find
+/// @param matches Array to store the matches into
+/// @param maxMatches Size of the array
+/// @return Number of matches stored
+uint Window_search(TermWindow *w, const char *pattern, WindowMatch *matches, uint maxMatches)
+{
+    uint32_t start = time_us_32();
+    uint len = strlen(pattern);
+    uint found = 0;
+
+    for (uint row = 0; row < w->term_rows && found < maxMatches && len; row++)
+    {
+        const WindowCell *cells = w->cells + row * w->maxCols;
+        uint col = 0;
+        while (col + len <= w->term_cols && found < maxMatches)
+        {
+            col += Search_first(cells + col, w->term_cols - len + 1 - col, pattern[0]);
+            if (col + len > w->term_cols)
+                break;
+
+            uint i = 1;
+            while (i < len && cells[col + i].c == pattern[i])
+                i++;
+            if (i == len)
+            {
+                matches[found++] = (WindowMatch){row, col, len};
+                col += len;
+            }
+            else
+                col++;
+        }
+    }
+
+    searchTime = time_us_32() - start;
+    return found;
+}
+
+/// @brief Draws the highlighted cells of a window, inverted or as they are stored
+/// @param direct whether to draw straight into the framebuffer, for a caller which has already taken the window's output
+/// @return false if the window is in an update, which then redraws the cells as they are stored when it ends
+static bool Search_drawMatches(TermWindow *w, bool highlighted, bool direct)
+{
+    bool drawn = true;
+    // the text may have scrolled since the matches were found
+    uint scrolled = w->scrollCount - w->highlightScroll;
+    for (int i = 0; i < w->nrHighlights; i++)
+    {
+        WindowMatch *m = &w->highlights[i];
+        if (m->row < scrolled)
+            continue;
+        uint row = m->row - scrolled;
+        for (int col = m->col; col < m->col + m->len; col++)
+        {
+            WindowCell *cell = &w->cells[row * w->maxCols + col];
+            uint8_t attr = highlighted ? cell->attr ^ ATTR_INVERSE : cell->attr;
+            if (direct)
+                Window_drawGlyph(w, col, row, cell->c, attr);
+            else
+                drawn &= Window_drawCell(w, col, row, attr);
+        }
+    }
+    return drawn;
+}
+
+/// @brief Draws the highlights of a window which were held back by an update (or a dialog over the window).
+/// Called when the update is drawn, with the window's output taken.
+/// @param w Window
+void Window_drawHighlights(TermWindow *w)
+{
+    w->highlightPending = false;
+    Search_drawMatches(w, true, true);
+}
+
+/// @brief Highlights a string everywhere it is shown in a window, by inverting the colours of the matching cells.
+/// Only those cells are redrawn, or when the window is in an update (or under a dialog), they are drawn when it ends.
+/// The previous highlights of the window are cleared.
+/// @param w Window to search
+/// @param pattern String to find, or an empty string to only clear the highlights
+/// @return Number of matches highlighted (at most MAX_HIGHLIGHTS)
+uint Window_highlight(TermWindow *w, const char *pattern)
+{
+    Window_clearHighlight(w);
+    if (w->highlights == NULL)
+        w->highlights = pvPortMalloc(MAX_HIGHLIGHTS * sizeof(WindowMatch));
+
+    w->nrHighlights = Window_search(w, pattern, w->highlights, MAX_HIGHLIGHTS);
+    w->highlightScroll = w->scrollCount;
+    if (!Search_drawMatches(w, true, false))
+        w->highlightPending = true;
+    return w->nrHighlights;
+}
+
+/// @brief Removes the highlights of a window, redrawing the highlighted cells as they are stored
+/// @param w Window
+void Window_clearHighlight(TermWindow *w)
+{
+    Search_drawMatches(w, false, false);
+    w->nrHighlights = 0;
+    w->highlightPending = false;
+}
+
+/// @brief Returns how long the last search took
+/// @return Time in microseconds
+uint32_t Window_getSearchTime()
+{
+    return searchTime;
+}
+
+void searchTask(void *p)
+{
+    char pattern[HISTORY_LINE_LEN];
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        TermWindow *d = Window_openDialog((FB_WIDTH - SEARCH_DIALOG_WIDTH) / 2, (FB_HEIGHT - SEARCH_DIALOG_HEIGHT) / 2,
+                                          SEARCH_DIALOG_WIDTH, SEARCH_DIALOG_HEIGHT, "Find", CYAN);
+        if (d != NULL)
+        {
+            Window_printString(d, "Find: ");
+            Window_readLine(d, pattern, sizeof(pattern));
+            Window_closeDialog(d);
+            Window_highlight(searchTarget, pattern);
+        }
+        searchBusy = false;
+    }
+}
+
+/// @brief Opens the search prompt for the window in focus. Called by the input task when the search key is pressed.
+/// @return false if a search is already in progress
+bool Window_requestSearch()
+{
+    if (searchBusy || searchHandle == NULL || activeWindow == NULL)
+        return false;
+
+    searchBusy = true;
+    searchTarget = activeWindow;
+    xTaskNotifyGive(searchHandle);
+    return true;
+}
+
+/// @brief Binds a key to searching the window in focus: it opens a prompt, and what is typed is highlighted in the window.
+/// Searching for nothing clears the highlights.
+/// @param key Key to bind
+void Window_enableSearchKey(char key)
+{
+    if (searchHandle == NULL)
+        xTaskCreate(searchTask, "Search", SEARCH_STACK, NULL, 1, &searchHandle);
+    searchKey = key;
+}
@@ -0,0 +1,204 @@
+#include "pico/stdlib.h"
+#include "string.h"
+
+#include "window.h"
+#include "window_pixel.h"
+
+// Snapshot layout: header, then the rectangle's framebuffer bytes, row after row, as RLE packets.
+// A packet starting with a byte below 0x80 is followed by that many + 1 literal bytes,
+// otherwise the low 7 bits + 1 give how many times the following byte is repeated.
+#define SNAPSHOT_MAGIC 'S'
+#define SNAPSHOT_HEADER_LEN 9
+#define SNAPSHOT_MAX_PACKET 128
+
+typedef struct SnapshotRect
+{
+    uint xByte, y;
+    uint rowBytes, height;
+
+} SnapshotRect;
+
+static inline uint8_t *Snapshot_pointer(SnapshotRect *r, uint i)
+{
+    return Pixel_row(r->y + i / r->rowBytes) + r->xByte + i % r->rowBytes;
+}
+
+static inline uint8_t Snapshot_byte(SnapshotRect *r, uint i)
+{
+    return *Snapshot_pointer(r, i);
+}
+
+static void Snapshot_putWord(uint8_t *buf, uint v)
+{
+    buf[0] = v & 0xFF;
+    buf[1] = v >> 8;
+}
+
+static uint Snapshot_getWord(const uint8_t *buf)
+{
+    return buf[0] | (buf[1] << 8);
+}
+
+static uint Snapshot_runLength(SnapshotRect *r, uint i, uint total)
+{
+    uint8_t b = Snapshot_byte(r, i);
+    uint n = 1;
+    while (i + n < total && n < SNAPSHOT_MAX_PACKET && Snapshot_byte(r, i + n) == b)
+        n++;
+    return n;
+}
+
+/// @brief Compresses a rectangle of the screen into a buffer
+/// @param x X coordinate of the rectangle, rounded down to a framebuffer byte
+/// @param y Y coordinate of the rectangle
+/// @param width Width of the rectangle, rounded up to a framebuffer byte
+/// @param height Height of the rectangle
+/// @param buf Buffer to write the snapshot into
+/// @param bufLen Size of the buffer
+/// @return Length of the snapshot, or 0 if it does not fit into the buffer or the rectangle is off screen
+uint Window_snapshotRect(uint x, uint y, uint width, uint height, uint8_t *buf, uint bufLen)
+{
+    // parts of the rectangle off screen are left out
+    if (x >= FB_WIDTH || y >= FB_HEIGHT || width == 0 || height == 0)
+        return 0;
+    if (width > FB_WIDTH - x)
+        width = FB_WIDTH - x;
+    if (height > FB_HEIGHT - y)
+        height = FB_HEIGHT - y;
+
+    SnapshotRect r = {x / FB_PIXELS_PER_BYTE, y, FB_BYTES(width + x % FB_PIXELS_PER_BYTE), height};
+    uint total = r.rowBytes * r.height;
+
+    if (bufLen < SNAPSHOT_HEADER_LEN)
+        return 0;
+    buf[0] = SNAPSHOT_MAGIC;
+    Snapshot_putWord(buf + 1, r.xByte);
+    Snapshot_putWord(buf + 3, r.y);
+    Snapshot_putWord(buf + 5, r.rowBytes);
+    Snapshot_putWord(buf + 7, r.height);
+    uint len = SNAPSHOT_HEADER_LEN;
+
+    uint i = 0;
+    while (i < total)
+    {
+        uint n = Snapshot_runLength(&r, i, total);
+        if (n >= 2)
+        {
+            if (len + 2 > bufLen)
+                return 0;
+            buf[len++] = 0x80 | (n - 1);
+            buf[len++] = Snapshot_byte(&r, i);
+        }
+        else
+        {
+            // literal bytes until a run of 3 or more starts
+            while (i + n < total && n < SNAPSHOT_MAX_PACKET && Snapshot_runLength(&r, i + n, total) < 3)
+                n++;
+            if (len + 1 + n > bufLen)
+                return 0;
+            buf[len++] = n - 1;
+            for (int j = 0; j < n; j++)
+                buf[len++] = Snapshot_byte(&r, i + j);
+        }
+        i += n;
+    }
+
+    return len;
+}
+
+/// @brief Compresses the whole screen into a buffer
+/// @param buf Buffer to write the snapshot into
+/// @param bufLen Size of the buffer
+/// @return Length of the snapshot, or 0 if it does not fit into the buffer
+uint Window_snapshotScreen(uint8_t *buf, uint bufLen)
+{
+    return Window_snapshotRect(0, 0, FB_WIDTH, FB_HEIGHT, buf, bufLen);
+}
+
+/// @brief Compresses the contents of a window into a buffer
+/// @param w Window to capture
+/// @param buf Buffer to write the snapshot into
+/// @param bufLen Size of the buffer
+/// @return Length of the snapshot, or 0 if it does not fit into the buffer
+uint Window_snapshotWindow(TermWindow *w, uint8_t *buf, uint bufLen)
+{
+    return Window_snapshotRect(w->xPos, w->yPos, w->xRes, w->yRes, buf, bufLen);
+}
+
+/// @brief Decodes the packets of a snapshot, into the framebuffer if write is set
+/// @return false if the packets do not cover the rectangle exactly
+static bool Snapshot_decode(const uint8_t *buf, uint len, SnapshotRect *r, bool write)
+{
+    uint total = r->rowBytes * r->height;
+    uint pos = SNAPSHOT_HEADER_LEN;
+    uint i = 0;
+
+    while (pos < len && i < total)
+    {
+        uint8_t header = buf[pos++];
+        bool repeat = header & 0x80;
+        uint n = (header & 0x7F) + 1;
+        if (i + n > total || pos + (repeat ? 1 : n) > len)
+            return false;
+        if (!write)
+        {
+            pos += repeat ? 1 : n;
+            i += n;
+            continue;
+        }
+
+        // packets may continue on the next row
+        while (n)
+        {
+            uint chunk = r->rowBytes - i % r->rowBytes;
+            if (chunk > n)
+                chunk = n;
+            if (repeat)
+                memset(Snapshot_pointer(r, i), buf[pos], chunk);
+            else
+            {
+                memcpy(Snapshot_pointer(r, i), buf + pos, chunk);
+                pos += chunk;
+            }
+            i += chunk;
+            n -= chunk;
+        }
+        if (repeat)
+            pos++;
+    }
+
+    return i == total;
+}
+
+/// @brief Draws a snapshot back onto the screen, at the place it was taken from.
+/// The snapshot is checked first, so nothing is drawn from a malformed one.
+/// @param buf Snapshot
+/// @param len Length of the snapshot
+/// @return false if the snapshot is malformed or does not fit on the screen
+bool Window_restoreSnapshot(const uint8_t *buf, uint len)
+{
+    if (len < SNAPSHOT_HEADER_LEN || buf[0] != SNAPSHOT_MAGIC)
+        return false;
+
+    SnapshotRect r = {Snapshot_getWord(buf + 1), Snapshot_getWord(buf + 3), Snapshot_getWord(buf + 5), Snapshot_getWord(buf + 7)};
+    if (r.rowBytes == 0 || r.height == 0 || r.xByte + r.rowBytes > FB_STRIDE || r.y + r.height > FB_HEIGHT)
+        return false;
+
+    if (!Snapshot_decode(buf, len, &r, false))
+        return false;
+    return Snapshot_decode(buf, len, &r, true);
+}
+
+/// @brief Computes a checksum (32 bit FNV-1a) of everything on screen, to compare runs of a scenario without storing snapshots
+/// @return Checksum of the framebuffer
+uint32_t Window_screenChecksum()
+{
+    uint32_t h = 2166136261u;
+    for (int y = 0; y < FB_HEIGHT; y++)
+    {
+        uint8_t *row = Pixel_row(y);
+        for (int i = 0; i < FB_BYTES(FB_WIDTH); i++)
+            h = (h ^ row[i]) * 16777619u;
+    }
+    return h;
+}
@@ -0,0 +1,171 @@
+#include "pico/stdlib.h"
+#include "stdio.h"
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#include "window.h"
+#include "window_rtos.h"
+#include "ps2.h"
+
+static uint Source_readPs2(WindowInputSource *s, char *buf, uint len)
+{
+    uint n = 0;
+    while (n < len && PS2_keyAvailable())
+        buf[n++] = PS2_readKey();
+    return n;
+}
+
+// UART or USB-CDC, whichever stdio is set up on. Do not use together with the remote mirror, which reads the same link.
+static uint Source_readStdio(WindowInputSource *s, char *buf, uint len)
+{
+    uint n = 0;
+    int c;
+    while (n < len && (c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT)
+        buf[n++] = c;
+    return n;
+}
+
+static uint Source_readReplay(WindowInputSource *s, char *buf, uint len)
+{
+    const char *script = s->data;
+    uint n = 0;
+    while (n < len && s->pos < s->len)
+        buf[n++] = script[s->pos++];
+    return n;
+}
+
+static uint Source_readHarness(WindowInputSource *s, char *buf, uint len)
+{
+    uint n = 0;
+    while (n < len && xQueueReceive((QueueHandle_t)s->data, &buf[n], 0) == pdTRUE)
+        n++;
+    return n;
+}
+
+WindowInputSource Window_ps2Input = {.name = "PS/2", .read = Source_readPs2};
+WindowInputSource Window_stdioInput = {.name = "stdio", .read = Source_readStdio};
+
+static WindowInputSource *sources[MAX_INPUT_SOURCES] = {&Window_ps2Input};
+static volatile uint nrSources = 1;
+
+/// @brief Delivers the pending keys of a source to the window in focus, as one batch
+/// @return number of keys consumed
+static uint Source_route(WindowInputSource *s)
+{
+    uint n = 0;
+
+    takeKeySemaphore();
+    while (n < s->pendingLen)
+    {
+        KeyRoute r = Window_deliverKey(s->pending[s->pendingPos + n]);
+        if (r == KEY_FULL)
+            break; // the window is not reading fast enough, keep the rest for later
+        if (r == KEY_DELIVERED)
+            s->delivered++;
+        else if (r == KEY_DROPPED)
+            s->dropped++;
+        n++;
+    }
+    giveKeySemaphore();
+
+    s->pendingPos += n;
+    s->pendingLen -= n;
+    if (s->pendingLen)
+        s->stalls++;
+    return n;
+}
+
+/// @brief Reads every input source once and routes what was read. Called by the input task.
+/// @return true if any key was consumed
+bool Window_pollInputSources()
+{
+    bool progress = false;
+
+    for (int i = 0; i < nrSources; i++)
+    {
+        WindowInputSource *s = sources[i];
+
+        // A source is only read again once everything it gave before has been delivered
+        if (s->pendingLen == 0)
+        {
+            s->pendingPos = 0;
+            s->pendingLen = s->read(s, s->pending, INPUT_BATCH_LEN);
+            s->received += s->pendingLen;
+        }
+
+        if (s->pendingLen && Source_route(s))
+            progress = true;
+    }
+
+    return progress;
+}
+
+/// @brief Adds a source of keypresses. The PS/2 keyboard is always a source.
+/// @param s Input source
+/// @return false if there are already MAX_INPUT_SOURCES sources
+bool Window_addInputSource(WindowInputSource *s)
+{
+    if (nrSources == MAX_INPUT_SOURCES)
+        return false;
+
+    s->pendingPos = s->pendingLen = 0;
+    s->received = s->delivered = s->dropped = s->stalls = 0;
+    sources[nrSources] = s;
+    nrSources++;
+    return true;
+}
+
+/// @brief Initializes an input source which types out a script kept in memory, such as a test scenario or a config blob
+/// @param s Input source to initialize, then to be added with Window_addInputSource
+/// @param name Name of the source
+/// @param script Keys to type
+/// @param len Number of keys
+void Window_initReplayInput(WindowInputSource *s, const char *name, const char *script, uint len)
+{
+    s->name = name;
+    s->read = Source_readReplay;
+    s->data = (void *)script;
+    s->pos = 0;
+    s->len = len;
+}
+
+/// @brief Initializes an input source which other tasks (such as a test harness) can push keys into with Window_injectKeys
+/// @param s Input source to initialize, then to be added with Window_addInputSource
+/// @param name Name of the source
+/// @param length How many keys can wait in the source
+void Window_initHarnessInput(WindowInputSource *s, const char *name, uint length)
+{
+    s->name = name;
+    s->read = Source_readHarness;
+    s->data = xQueueCreate(length, sizeof(char));
+}
+
+/// @brief Pushes keys into a harness input source, blocking while the source is full
+/// @param s Harness input source
+/// @param keys Keys to push
+/// @param len Number of keys
+/// @param ms How long to wait for room for each key, or WINDOW_WAIT_FOREVER
+/// @return Number of keys pushed
+uint Window_injectKeys(WindowInputSource *s, const char *keys, uint len, uint ms)
+{
+    TickType_t ticks = (ms == WINDOW_WAIT_FOREVER) ? portMAX_DELAY : ms / portTICK_PERIOD_MS;
+    uint n = 0;
+    while (n < len && xQueueSendToBack((QueueHandle_t)s->data, &keys[n], ticks) == pdTRUE)
+        n++;
+    return n;
+}
+
+/// @brief Returns the counters of an input source, to measure input throughput
+/// @param s Input source
+/// @param received where to store the number of keys read from the source
+/// @param delivered where to store the number of keys delivered to windows
+/// @param dropped where to store the number of keys dropped because no window was in focus
+/// @param stalls where to store how many times the window in focus could not take all keys of a batch
+void Window_getInputStats(WindowInputSource *s, uint32_t *received, uint32_t *delivered, uint32_t *dropped, uint32_t *stalls)
+{
+    *received = s->received;
+    *delivered = s->delivered;
+    *dropped = s->dropped;
+    *stalls = s->stalls;
+}
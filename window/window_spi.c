@@ -0,0 +1,117 @@
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "hardware/gpio.h"
+
+#include "window.h"
+#include "window_pixel.h"
+
+// MIPI DCS commands, common to ST7789 and ILI9341 panels
+#define SPI_SWRESET 0x01
+#define SPI_SLPOUT 0x11
+#define SPI_DISPON 0x29
+#define SPI_CASET 0x2A
+#define SPI_RASET 0x2B
+#define SPI_RAMWR 0x2C
+#define SPI_MADCTL 0x36
+#define SPI_COLMOD 0x3A
+
+#define SPI_COLMOD_16BIT 0x55
+#define SPI_MADCTL_LANDSCAPE 0x60
+
+static spi_inst_t *panelSpi;
+static uint panelDc, panelCs;
+
+// RGB565 value of each colour, stored big-endian as the panel expects
+static uint16_t panelColours[8];
+
+static void Spi_command(uint8_t cmd, const uint8_t *data, uint len)
+{
+    gpio_put(panelCs, 0);
+    gpio_put(panelDc, 0);
+    spi_write_blocking(panelSpi, &cmd, 1);
+    gpio_put(panelDc, 1);
+    if (len)
+        spi_write_blocking(panelSpi, data, len);
+    gpio_put(panelCs, 1);
+}
+
+static void Spi_setAddressWindow(uint x, uint y, uint width, uint height)
+{
+    uint x1 = x + width - 1;
+    uint y1 = y + height - 1;
+    uint8_t cols[4] = {x >> 8, x & 0xFF, x1 >> 8, x1 & 0xFF};
+    uint8_t rows[4] = {y >> 8, y & 0xFF, y1 >> 8, y1 & 0xFF};
+    Spi_command(SPI_CASET, cols, 4);
+    Spi_command(SPI_RASET, rows, 4);
+}
+
+/// @brief Pushes a region of the framebuffer to the panel, converting each pixel to RGB565
+static uint Spi_flush(uint x, uint y, uint width, uint height)
+{
+    static uint16_t line[FB_WIDTH]; // only the render task flushes
+
+    Spi_setAddressWindow(x, y, width, height);
+
+    uint8_t cmd = SPI_RAMWR;
+    gpio_put(panelCs, 0);
+    gpio_put(panelDc, 0);
+    spi_write_blocking(panelSpi, &cmd, 1);
+    gpio_put(panelDc, 1);
+    for (int i = 0; i < height; i++)
+    {
+        uint8_t *row = Pixel_row(y + i);
+        for (int j = 0; j < width; j++)
+            line[j] = panelColours[Pixel_get(row, x + j) & 7];
+        spi_write_blocking(panelSpi, (uint8_t *)line, 2 * width);
+    }
+    gpio_put(panelCs, 1);
+
+    return 2 * width * height;
+}
+
+static WindowDisplay spiDisplay = {Spi_flush};
+
+/// @brief Initializes an SPI TFT panel (ST7789, ILI9341 or compatible, at the framebuffer's resolution) as display backend.
+/// The framebuffer stays in RAM, and only the regions which changed are pushed to the panel.
+/// @param spi SPI instance the panel is connected to, already set up with spi_init and the pin functions
+/// @param dc Data/command pin
+/// @param cs Chip select pin
+/// @param rst Reset pin
+/// @return Display backend, to be passed to Window_initIOWithDisplay or Window_setDisplay
+const WindowDisplay *Window_initSpiDisplay(spi_inst_t *spi, uint dc, uint cs, uint rst)
+{
+    panelSpi = spi;
+    panelDc = dc;
+    panelCs = cs;
+
+    for (int i = 0; i < 8; i++)
+    {
+        uint16_t c = ((i & RED) ? 0xF800 : 0) | ((i & GREEN) ? 0x07E0 : 0) | ((i & BLUE) ? 0x001F : 0);
+        panelColours[i] = (c >> 8) | (c << 8);
+    }
+
+    gpio_init(dc);
+    gpio_set_dir(dc, GPIO_OUT);
+    gpio_init(cs);
+    gpio_set_dir(cs, GPIO_OUT);
+    gpio_put(cs, 1);
+    gpio_init(rst);
+    gpio_set_dir(rst, GPIO_OUT);
+
+    gpio_put(rst, 0);
+    sleep_ms(10);
+    gpio_put(rst, 1);
+    sleep_ms(120);
+
+    Spi_command(SPI_SWRESET, NULL, 0);
+    sleep_ms(150);
+    Spi_command(SPI_SLPOUT, NULL, 0);
+    sleep_ms(120);
+    uint8_t colmod = SPI_COLMOD_16BIT;
+    Spi_command(SPI_COLMOD, &colmod, 1);
+    uint8_t madctl = SPI_MADCTL_LANDSCAPE;
+    Spi_command(SPI_MADCTL, &madctl, 1);
+    Spi_command(SPI_DISPON, NULL, 0);
+
+    return &spiDisplay;
+}
@@ -0,0 +1,229 @@
+#include "pico/stdlib.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "window.h"
+#include "window_rtos.h"
+
+// Trace layout: magic, version, then the events (see TRACE_* in window_rtos.h)
+#define TRACE_MAGIC 'T'
+#define TRACE_VERSION 1
+#define TRACE_HEADER_LEN 2
+#define TRACE_MAX_EVENT_LEN 11
+#define TRACE_MAX_TASKS 16
+
+// Gaps in a timed replay longer than this are slept through, shorter ones are waited out
+#define REPLAY_SLEEP_US 2000
+
+volatile bool traceActive = false;
+
+static uint8_t *traceBuf;
+static uint traceSize, traceLen;
+static uint32_t traceLast;
+
+static void *traceTasks[TRACE_MAX_TASKS];
+static uint nrTraceTasks;
+
+static uint Trace_putVarint(uint8_t *buf, uint32_t v)
+{
+    uint n = 0;
+    while (v >= 0x80)
+    {
+        buf[n++] = v | 0x80;
+        v >>= 7;
+    }
+    buf[n++] = v;
+    return n;
+}
+
+static uint32_t Trace_getVarint(const uint8_t *buf, uint len, uint *pos)
+{
+    uint32_t v = 0;
+    for (int shift = 0; *pos < len && shift < 32; shift += 7)
+    {
+        uint8_t b = buf[(*pos)++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    return v;
+}
+
+/// @brief Appends an event to the trace. Interrupts have to be disabled.
+static void Trace_put(uint8_t type, uint8_t window, uint32_t arg)
+{
+    if (!traceActive)
+        return;
+
+    // Once the buffer is full the trace ends, so that it stays a complete prefix of the session
+    if (traceLen + TRACE_MAX_EVENT_LEN > traceSize)
+    {
+        traceActive = false;
+        return;
+    }
+
+    uint32_t now = time_us_32();
+    traceBuf[traceLen++] = (type << 4) | window;
+    traceLen += Trace_putVarint(traceBuf + traceLen, now - traceLast);
+    traceLen += Trace_putVarint(traceBuf + traceLen, arg);
+    traceLast = now;
+}
+
+static uint8_t Trace_windowIndex(TermWindow *w)
+{
+    for (int i = 0; i < nrWindows; i++)
+        if (windowCarousel[i] == w)
+            return i;
+    return TRACE_NO_WINDOW;
+}
+
+/// @brief Records an API call or input event into the trace. Use through WINDOW_TRACE.
+void Window_traceEvent(uint8_t type, TermWindow *w, uint32_t arg)
+{
+    uint8_t window = Trace_windowIndex(w);
+    enterCritical();
+    Trace_put(type, window, arg);
+    exitCritical();
+}
+
+/// @brief Records a scheduling point. Overrides the task switch hook of the FreeRTOS configuration,
+/// which the kernel calls on every task switch with interrupts disabled.
+void vApplicationTaskSwitchedIn(void *task)
+{
+    if (!traceActive)
+        return;
+
+    uint id = 0;
+    while (id < nrTraceTasks && traceTasks[id] != task)
+        id++;
+    if (id == nrTraceTasks && nrTraceTasks < TRACE_MAX_TASKS)
+        traceTasks[nrTraceTasks++] = task;
+
+    Trace_put(TRACE_TASK, TRACE_NO_WINDOW, id);
+}
+
+/// @brief Starts recording input events, window API calls and task switches into a buffer
+/// @param buf Buffer for the trace
+/// @param len Size of the buffer. Recording stops when it is full.
+void Window_startTrace(uint8_t *buf, uint len)
+{
+    if (len < TRACE_HEADER_LEN)
+        return;
+
+    enterCritical();
+    traceBuf = buf;
+    traceSize = len;
+    traceBuf[0] = TRACE_MAGIC;
+    traceBuf[1] = TRACE_VERSION;
+    traceLen = TRACE_HEADER_LEN;
+    nrTraceTasks = 0;
+    traceLast = time_us_32();
+    traceActive = true;
+    exitCritical();
+}
+
+/// @brief Stops recording
+/// @return Length of the trace
+uint Window_stopTrace()
+{
+    enterCritical();
+    traceActive = false;
+    exitCritical();
+    return traceLen;
+}
+
+/// @brief Applies a recorded API call to the window it was made on
+/// @return false for events which are not API calls
+static bool Trace_apply(uint8_t type, TermWindow *w, uint32_t arg)
+{
+    switch (type)
+    {
+    case TRACE_WRITE:
+        Window_write(w, arg);
+        return true;
+    case TRACE_CURSOR:
+        Window_setCursor(w, arg & 0xFF, arg >> 8);
+        return true;
+    case TRACE_SCROLL:
+        Window_scrollLines(w, arg);
+        return true;
+    case TRACE_CLEAR:
+        Window_clear(w);
+        return true;
+    case TRACE_SIZE:
+        Window_setTextSize(w, arg);
+        return true;
+    case TRACE_ATTR:
+        Window_setTextColour(w, arg & 7);
+        Window_setBackgroundColour(w, (arg >> 3) & 7);
+        Window_setTextAttributes(w, arg);
+        return true;
+    case TRACE_FOCUS:
+        Window_setActiveWindow(w);
+        return true;
+    case TRACE_BEGIN:
+        Window_beginUpdate(w);
+        return true;
+    case TRACE_END:
+        Window_endUpdate(w);
+        return true;
+    case TRACE_CELL:
+        Window_putCell(w, (arg >> 16) & 0xFF, arg >> 24, arg & 0xFF, (arg >> 8) & 0xFF);
+        return true;
+    default:
+        // input and scheduling events only describe the recorded session
+        return false;
+    }
+}
+
+/// @brief Replays the API calls of a trace against the current windows, which have to be laid out as when it was recorded.
+/// Their tasks should be suspended, so that only the replay draws. Input and task switch events are not replayed.
+/// @param buf Trace
+/// @param len Length of the trace
+/// @param timed true to keep the recorded timing between calls, false to replay as fast as possible
+/// @param res where to store the timing and the checksum of the resulting screen
+/// @return false if the trace is malformed
+bool Window_replayTrace(const uint8_t *buf, uint len, bool timed, WindowReplayResult *res)
+{
+    if (len < TRACE_HEADER_LEN || buf[0] != TRACE_MAGIC || buf[1] != TRACE_VERSION)
+        return false;
+
+    *res = (WindowReplayResult){0};
+    uint64_t start = time_us_64();
+    uint pos = TRACE_HEADER_LEN;
+
+    while (pos < len)
+    {
+        uint8_t header = buf[pos++];
+        uint32_t dt = Trace_getVarint(buf, len, &pos);
+        uint32_t arg = Trace_getVarint(buf, len, &pos);
+        uint8_t window = header & 0x0F;
+        res->events++;
+        res->recordedUs += dt;
+
+        if (timed)
+        {
+            uint64_t target = start + res->recordedUs;
+            uint64_t now = time_us_64();
+            if (target > now + REPLAY_SLEEP_US)
+                vTaskDelay((target - now) / 1000 / portTICK_PERIOD_MS);
+            while (time_us_64() < target)
+                ;
+        }
+
+        if (window >= nrWindows)
+            continue;
+
+        uint64_t callStart = time_us_64();
+        if (Trace_apply(header >> 4, windowCarousel[window], arg))
+        {
+            res->busyUs += time_us_64() - callStart;
+            res->replayed++;
+        }
+    }
+
+    res->elapsedUs = time_us_64() - start;
+    res->checksum = Window_screenChecksum();
+    return true;
+}